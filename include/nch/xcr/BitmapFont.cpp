@@ -0,0 +1,285 @@
+#include "BitmapFont.h"
+#include <algorithm>
+#include <map>
+#include <nch/cpp-utils/log.h>
+#include <nch/cpp-utils/string-utils.h>
+#include <stdlib.h>
+#include <string.h>
+#include "OCRPreprocess.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace nch;
+
+BitmapFont::BitmapFont(){}
+
+bool BitmapFont::learn(const uint8_t* pixels, int w, int h, int pitch, const std::string& label, int inkThreshold)
+{
+    if(pixels==nullptr || w<=0 || h<=0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Sample image is empty");
+        return false;
+    }
+
+    /* Every non-space character of 'label' must be exactly one glyph of the sample */
+    std::vector<std::string> chars = splitUTF8(label);
+    std::vector<std::string> letters;
+    std::vector<bool> spaceBefore;
+    bool space = false;
+    for(size_t i = 0; i<chars.size(); i++) {
+        if(chars[i]==" ") { space = true; continue; }
+        letters.push_back(chars[i]);
+        spaceBefore.push_back(space && letters.size()>1);
+        space = false;
+    }
+
+    std::vector<uint8_t> ink = toInk(pixels, w, h, pitch);
+    int baseline;
+    std::vector<Segment> segs = segment(ink, w, h, inkThreshold, baseline);
+    if(segs.size()!=letters.size()) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Found %d glyphs in the sample but \"%s\" has %d characters (are some glyphs touching?)", (int)segs.size(), label.c_str(), (int)letters.size());
+        return false;
+    }
+
+    for(size_t i = 0; i<segs.size(); i++) {
+        const Segment& s = segs[i];
+        //How wide spaces are, compared to the gaps between letters
+        if(i>0) {
+            int gap = s.x0-segs[i-1].x1;
+            if(spaceBefore[i])  minSpaceGap = (minSpaceGap<0) ? gap : std::min(minSpaceGap, gap);
+            else                maxLetterGap = std::max(maxLetterGap, gap);
+        }
+
+        Glyph g;
+        g.ch = letters[i];
+        g.w = s.x1-s.x0; g.h = s.y1-s.y0;
+        g.baseOffset = s.y1-baseline;
+        g.ink = extract(ink, w, s.x0, s.y0, s.x1, s.y1);
+        for(size_t j = 0; j<g.ink.size(); j++) g.inkSum += g.ink[j];
+
+        //Skip exact duplicates (ex: the same letter twice in one sample)
+        bool dup = false;
+        for(size_t j = 0; j<glyphs.size() && !dup; j++) {
+            dup = glyphs[j].ch==g.ch && glyphs[j].w==g.w && glyphs[j].h==g.h && glyphs[j].ink==g.ink;
+        }
+        if(!dup) glyphs.push_back(g);
+    }
+    return true;
+}
+bool BitmapFont::learn(SDL_Surface* surf, const std::string& label, int inkThreshold)
+{
+    if(surf==nullptr) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "'surf' is NULL");
+        return false;
+    }
+    SDL_Surface* conv = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_BGRA32, 0);
+    if(conv==NULL) {
+        Log::errorv(__PRETTY_FUNCTION__, "SDL_ConvertSurfaceFormat()", SDL_GetError());
+        return false;
+    }
+    bool res = learn((const uint8_t*)conv->pixels, conv->w, conv->h, conv->pitch, label, inkThreshold);
+    SDL_FreeSurface(conv);
+    return res;
+}
+
+GlyphReadResult BitmapFont::read(const uint8_t* pixels, int w, int h, int pitch, const GlyphReadOptions& opts) const
+{
+    GlyphReadResult res;
+    res.minConfidence = 1;
+    if(pixels==nullptr || w<=0 || h<=0) return res;
+
+    std::vector<uint8_t> ink = toInk(pixels, w, h, pitch);
+    int baseline;
+    std::vector<Segment> segs = segment(ink, w, h, opts.inkThreshold, baseline);
+    int spaceThreshold = getSpaceThreshold();
+
+    std::vector<uint8_t> cand;
+    for(size_t i = 0; i<segs.size(); i++) {
+        const Segment& s = segs[i];
+        if(i>0 && s.x0-segs[i-1].x1>=spaceThreshold) {
+            res.text += " ";
+            res.confidences.push_back(1);
+            res.boxes.push_back(Rect(segs[i-1].x1, s.y0, s.x0-segs[i-1].x1, s.y1-s.y0));
+        }
+
+        /* Match glyphs left to right within the segment. Usually one glyph fills the whole segment, but touching glyphs (ex: kerned "rn") share one. */
+        for(int x = s.x0; x<s.x1; ) {
+            //Vertical extent of the ink for each candidate width, computed once per width
+            std::map<int, std::pair<int, int>> rowsByWidth;
+            const Glyph* best = nullptr;
+            float bestConf = -1;
+            int bestY0 = s.y0, bestY1 = s.y1;
+            for(size_t j = 0; j<glyphs.size(); j++) {
+                const Glyph& g = glyphs[j];
+                if(g.w>s.x1-x) continue;
+                auto itr = rowsByWidth.find(g.w);
+                if(itr==rowsByWidth.end()) {
+                    int y0 = 0, y1 = 0;
+                    if(!inkRows(ink, w, h, x, x+g.w, opts.inkThreshold, y0, y1)) y0 = y1 = -1;
+                    itr = rowsByWidth.insert(std::make_pair(g.w, std::make_pair(y0, y1))).first;
+                }
+                int y0 = itr->second.first, y1 = itr->second.second;
+                if(y0<0 || y1-y0!=g.h) continue;
+
+                //1 = identical, 0 = no ink in common
+                cand = extract(ink, w, x, y0, x+g.w, y1);
+                uint32_t candSum = 0;
+                for(size_t k = 0; k<cand.size(); k++) candSum += cand[k];
+                uint32_t total = g.inkSum+candSum;
+                float conf = total==0 ? 1 : 1.0f-(float)sad(g.ink.data(), cand.data(), cand.size())/total;
+                //Same bitmap at a different height (ex: ',' and ''') - trust the one sitting at the learned position
+                if(std::abs((y1-baseline)-g.baseOffset)>1) conf *= 0.5f;
+
+                if(conf>bestConf || (conf==bestConf && best!=nullptr && g.w>best->w)) {
+                    best = &g; bestConf = conf;
+                    bestY0 = y0; bestY1 = y1;
+                }
+            }
+
+            if(best==nullptr) {
+                //Nothing learned fits: give up on the rest of this segment
+                res.text += "?";
+                res.confidences.push_back(0);
+                res.boxes.push_back(Rect(x, s.y0, s.x1-x, s.y1-s.y0));
+                break;
+            }
+            res.text += bestConf>=opts.minConfidence ? best->ch : "?";
+            res.confidences.push_back(bestConf);
+            res.boxes.push_back(Rect(x, bestY0, best->w, bestY1-bestY0));
+            x += best->w;
+        }
+    }
+    for(size_t i = 0; i<res.confidences.size(); i++) res.minConfidence = std::min(res.minConfidence, res.confidences[i]);
+
+    /* Fall back to OCR if anything wasn't recognized */
+    if(opts.ocrFallback && res.minConfidence<opts.minConfidence) {
+        std::string text = StringUtils::trimmed(OCREngine::recognize(pixels, w, h, pitch, opts.ocrOptions));
+        if(text!="") {
+            res.text = text;
+            res.confidences.clear();
+            res.boxes.clear();
+            res.usedOCR = true;
+        }
+    }
+    return res;
+}
+
+int BitmapFont::getNumGlyphs() const { return glyphs.size(); }
+void BitmapFont::clear()
+{
+    glyphs.clear();
+    maxLetterGap = -1;
+    minSpaceGap = -1;
+}
+
+uint32_t BitmapFont::sad(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    uint32_t res = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for(; i+16<=n; i += 16) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a+i)), _mm_loadu_si128((const __m128i*)(b+i))));
+    }
+    res = _mm_cvtsi128_si32(acc)+_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+    for(; i<n; i++) res += abs(a[i]-b[i]);
+    return res;
+}
+
+std::vector<uint8_t> BitmapFont::toInk(const uint8_t* pixels, int w, int h, int pitch)
+{
+    //Ink = distance from the background color, so light-on-dark and dark-on-light text look the same
+    std::vector<uint8_t> res((size_t)w*h);
+    OCRPreprocess::toGray(pixels, w, h, pitch, res.data());
+    uint32_t hist[256] = { 0 };
+    for(size_t i = 0; i<res.size(); i++) hist[res[i]]++;
+    int bg = std::max_element(hist, hist+256)-hist;
+
+    //Stretched so that the strongest ink is 255 whatever the text/background contrast
+    int maxDist = 1;
+    for(int i = 0; i<256; i++) if(hist[i]>0) maxDist = std::max(maxDist, abs(i-bg));
+    uint8_t lut[256];
+    for(int i = 0; i<256; i++) lut[i] = abs(i-bg)*255/maxDist;
+    for(size_t i = 0; i<res.size(); i++) res[i] = lut[res[i]];
+    return res;
+}
+
+std::vector<BitmapFont::Segment> BitmapFont::segment(const std::vector<uint8_t>& ink, int w, int h, int inkThreshold, int& baseline)
+{
+    //Column projection: runs of columns containing ink are glyphs, runs of blank columns separate them
+    std::vector<bool> colOn(w, false);
+    for(int y = 0; y<h; y++) {
+        const uint8_t* row = ink.data()+(size_t)y*w;
+        for(int x = 0; x<w; x++) if(row[x]>=inkThreshold) colOn[x] = true;
+    }
+
+    std::vector<Segment> res;
+    for(int x = 0; x<w; ) {
+        if(!colOn[x]) { x++; continue; }
+        Segment s;
+        s.x0 = x;
+        while(x<w && colOn[x]) x++;
+        s.x1 = x;
+        inkRows(ink, w, h, s.x0, s.x1, inkThreshold, s.y0, s.y1);
+        res.push_back(s);
+    }
+
+    //Baseline = the most common glyph bottom
+    std::map<int, int> bottoms;
+    baseline = h;
+    int most = 0;
+    for(size_t i = 0; i<res.size(); i++) {
+        int n = ++bottoms[res[i].y1];
+        if(n>most || (n==most && res[i].y1>baseline)) { most = n; baseline = res[i].y1; }
+    }
+    return res;
+}
+
+bool BitmapFont::inkRows(const std::vector<uint8_t>& ink, int w, int h, int x0, int x1, int inkThreshold, int& y0, int& y1)
+{
+    y0 = -1; y1 = -1;
+    for(int y = 0; y<h; y++) {
+        const uint8_t* row = ink.data()+(size_t)y*w;
+        for(int x = x0; x<x1; x++) {
+            if(row[x]>=inkThreshold) {
+                if(y0<0) y0 = y;
+                y1 = y+1;
+                break;
+            }
+        }
+    }
+    return y0>=0;
+}
+
+std::vector<uint8_t> BitmapFont::extract(const std::vector<uint8_t>& ink, int w, int x0, int y0, int x1, int y1)
+{
+    std::vector<uint8_t> res((size_t)(x1-x0)*(y1-y0));
+    for(int y = y0; y<y1; y++) {
+        memcpy(res.data()+(size_t)(y-y0)*(x1-x0), ink.data()+(size_t)y*w+x0, x1-x0);
+    }
+    return res;
+}
+
+std::vector<std::string> BitmapFont::splitUTF8(const std::string& s)
+{
+    std::vector<std::string> res;
+    for(size_t i = 0; i<s.size(); i++) {
+        //Continuation bytes (10xxxxxx) belong to the previous character
+        if(((uint8_t)s[i]&0xc0)==0x80 && !res.empty()) res.back() += s[i];
+        else res.push_back(std::string(1, s[i]));
+    }
+    return res;
+}
+
+int BitmapFont::getSpaceThreshold() const
+{
+    if(maxLetterGap>=0 && minSpaceGap>maxLetterGap) return (maxLetterGap+minSpaceGap+1)/2;
+    if(minSpaceGap>0) return minSpaceGap;
+    if(maxLetterGap>=0) return maxLetterGap*2+2;
+
+    //Nothing learned: about a third of the glyph height
+    int maxH = 0;
+    for(size_t i = 0; i<glyphs.size(); i++) maxH = std::max(maxH, glyphs[i].h);
+    return std::max(2, maxH/3);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <nch/sdl-utils/rect.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "OCREngine.h"
+
+namespace nch {
+/// @brief Settings for BitmapFont::read().
+struct GlyphReadOptions {
+    int inkThreshold = 64;          //How far (0-255) a pixel's gray level must be from the background to count as part of a glyph
+    float minConfidence = 0.85f;    //Characters below this confidence (0-1) count as unrecognized ("?")
+    bool ocrFallback = false;       //If any character is unrecognized, read the whole image with OCR (OCREngine) instead
+    OCROptions ocrOptions;          //Settings for the OCR fallback, ex: psm = 7 (single line)
+};
+/// @brief Text read by BitmapFont::read().
+struct GlyphReadResult {
+    std::string text;               //"?" for glyphs that match no learned glyph well enough (see 'minConfidence')
+    std::vector<float> confidences; //One per character of 'text' (UTF-8 aware), 0-1. Spaces are always 1.
+    std::vector<nch::Rect> boxes;   //One per character of 'text', in image coordinates
+    float minConfidence = 0;        //Lowest of 'confidences' (1 if there is no text)
+    bool usedOCR = false;           //True if the OCR fallback replaced the text (then 'confidences' and 'boxes' are empty)
+};
+
+class BitmapFont {
+public:
+    BitmapFont();
+
+    /// @brief Learn the glyphs of a font from a sample image: a single line of text whose characters are 'label'.
+    /// @brief Glyphs in the sample must not touch each other, and each must be one unbroken run of columns. Spaces in 'label' are only used to learn how wide a space is.
+    /// @brief Learning several samples with the same character (ex: different colors) keeps every distinct version.
+    /// @param pixels BGRA32 pixels, 'pitch' bytes per row.
+    /// @return False if the number of glyphs found in the image isn't the number of (non-space) characters in 'label'.
+    bool learn(const uint8_t* pixels, int w, int h, int pitch, const std::string& label, int inkThreshold = 64);
+    bool learn(SDL_Surface* surf, const std::string& label, int inkThreshold = 64);
+
+    /// @brief Read a single line of text written in this font, without Tesseract: the line is split into glyphs by column projection
+    /// @brief (touching glyphs are split by trying every learned width), then each glyph is compared to every learned glyph of the same size (sum of absolute differences).
+    /// @param pixels BGRA32 pixels, 'pitch' bytes per row. The background should be a flat color (any color, light or dark).
+    GlyphReadResult read(const uint8_t* pixels, int w, int h, int pitch, const GlyphReadOptions& opts = GlyphReadOptions()) const;
+
+    int getNumGlyphs() const;
+    void clear();
+
+    /// @return The sum of absolute differences between 'n' bytes of 'a' and 'b', 16 bytes at a time with SSE2 where available.
+    static uint32_t sad(const uint8_t* a, const uint8_t* b, size_t n);
+private:
+    struct Glyph {
+        std::string ch;
+        int w = 0; int h = 0;
+        int baseOffset = 0;         //Bottom row relative to the line's baseline (negative above it, ex: apostrophes; positive below, ex: descenders)
+        std::vector<uint8_t> ink;   //'w'x'h' ink levels (distance from the background color)
+        uint32_t inkSum = 0;
+    };
+    struct Segment { int x0, x1, y0, y1; };     //[x0, x1) x [y0, y1)
+
+    static std::vector<uint8_t> toInk(const uint8_t* pixels, int w, int h, int pitch);
+    static std::vector<Segment> segment(const std::vector<uint8_t>& ink, int w, int h, int inkThreshold, int& baseline);
+    static bool inkRows(const std::vector<uint8_t>& ink, int w, int h, int x0, int x1, int inkThreshold, int& y0, int& y1);
+    static std::vector<uint8_t> extract(const std::vector<uint8_t>& ink, int w, int x0, int y0, int x1, int y1);
+    static std::vector<std::string> splitUTF8(const std::string& s);
+    int getSpaceThreshold() const;
+
+    std::vector<Glyph> glyphs;
+    int maxLetterGap = -1;      //Widest gap seen between letters of a word
+    int minSpaceGap = -1;       //Narrowest gap seen for a space
+};
+}
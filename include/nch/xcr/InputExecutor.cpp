@@ -0,0 +1,10 @@
+#include "InputExecutor.h"
+
+using namespace nch;
+
+WorkerQueue InputExecutor::queue(1, &InputExecutor::stop);
+
+void InputExecutor::drain() { queue.drain(); }
+void InputExecutor::stop() { queue.stop(); }
+size_t InputExecutor::getNumPending() { return queue.getNumPending(); }
+bool InputExecutor::isInputThread() { return queue.isWorkerThread(); }
@@ -0,0 +1,26 @@
+#pragma once
+#include <future>
+#include "WorkerQueue.h"
+
+namespace nch { class InputExecutor {
+public:
+    /// @brief Queue 'task' to run on the input thread and return immediately.
+    /// @brief Tasks run one at a time in submission order, so input submitted from one thread is never reordered or interleaved.
+    /// @brief The input thread is started on first use.
+    /// @return A future that becomes ready once 'task' has finished (holding its return value).
+    template<typename F> static auto submit(F task) -> std::future<decltype(task())> {
+        return queue.submit(task);
+    }
+
+    /// @brief Block until every task submitted so far has finished.
+    static void drain();
+    /// @brief Finish every queued task, then stop the input thread. Submitting again restarts it.
+    /// @brief Called by Xcalibur::free() and automatically at exit.
+    static void stop();
+    /// @return The number of tasks that are queued or running.
+    static size_t getNumPending();
+    /// @return True if called from the input thread (waiting on a future from there would deadlock).
+    static bool isInputThread();
+private:
+    static WorkerQueue queue;   //A single worker: the input thread
+}; }
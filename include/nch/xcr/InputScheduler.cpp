@@ -0,0 +1,179 @@
+#include "InputScheduler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <nch/cpp-utils/log.h>
+#include <nch/cpp-utils/shell.h>
+#include <sstream>
+#include <time.h>
+#include "XKeymap.h"
+#include "XNativeInput.h"
+
+using namespace nch;
+
+InputScript& InputScript::keyDown(const std::string& key, double afterMS)   { InputEvent ev; ev.type = InputEvent::KEY_DOWN; ev.key = key; return add(ev, afterMS); }
+InputScript& InputScript::keyUp(const std::string& key, double afterMS)     { InputEvent ev; ev.type = InputEvent::KEY_UP; ev.key = key; return add(ev, afterMS); }
+InputScript& InputScript::keysymDown(unsigned long keysym, double afterMS)  { InputEvent ev; ev.type = InputEvent::KEYSYM_DOWN; ev.keysym = keysym; return add(ev, afterMS); }
+InputScript& InputScript::keysymUp(unsigned long keysym, double afterMS)    { InputEvent ev; ev.type = InputEvent::KEYSYM_UP; ev.keysym = keysym; return add(ev, afterMS); }
+InputScript& InputScript::mouseMove(int x, int y, double afterMS)           { InputEvent ev; ev.type = InputEvent::MOUSE_MOVE; ev.x = x; ev.y = y; return add(ev, afterMS); }
+InputScript& InputScript::mouseDown(int btn, double afterMS)                { InputEvent ev; ev.type = InputEvent::MOUSE_DOWN; ev.btn = btn; return add(ev, afterMS); }
+InputScript& InputScript::mouseUp(int btn, double afterMS)                  { InputEvent ev; ev.type = InputEvent::MOUSE_UP; ev.btn = btn; return add(ev, afterMS); }
+InputScript& InputScript::wait(double ms)                                   { InputEvent ev; ev.type = InputEvent::WAIT; return add(ev, ms); }
+
+InputScript InputScript::typing(const std::string& text, uint64_t seed, DelayDistribution keyDownDist, DelayDistribution keyUpDist)
+{
+    InputScript res;
+    std::mt19937_64 rng(seed);
+
+    double pendingMS = 0;
+    std::vector<uint32_t> cps = XKeymap::decodeUTF8(text);
+    for(size_t i = 0; i<cps.size(); i++) {
+        KeySym sym = XKeymap::unicodeToKeysym(cps[i]);
+        if(sym==NoSymbol) continue;
+        res.keysymDown(sym, pendingMS);
+        res.keysymUp(sym, keyDownDist(rng));
+        pendingMS = keyUpDist(rng);
+    }
+    //Trailing pause after the last key up, like XTools::naturalKeystroke()
+    if(!res.events.empty()) res.wait(pendingMS);
+    return res;
+}
+InputScript InputScript::typing(const std::string& text, uint64_t seed) {
+    return typing(text, seed, uniformDelay(15, 30), uniformDelay(35, 90));
+}
+
+DelayDistribution InputScript::uniformDelay(double minMS, double maxMS)
+{
+    return [minMS, maxMS](std::mt19937_64& rng) {
+        std::uniform_real_distribution<double> dist(minMS, maxMS);
+        return dist(rng);
+    };
+}
+DelayDistribution InputScript::normalDelay(double meanMS, double stddevMS, double minMS)
+{
+    return [meanMS, stddevMS, minMS](std::mt19937_64& rng) {
+        std::normal_distribution<double> dist(meanMS, stddevMS);
+        return std::max(minMS, dist(rng));
+    };
+}
+
+InputScript& InputScript::add(InputEvent ev, double afterMS)
+{
+    durationMS += std::max(0.0, afterMS);
+    ev.atMS = durationMS;
+    events.push_back(ev);
+    return *this;
+}
+
+std::mutex InputScheduler::runsMtx;
+std::condition_variable InputScheduler::runsDone;
+int InputScheduler::numRuns = 0;
+std::atomic<bool> InputScheduler::stopping(false);
+
+InputScriptReport InputScheduler::run(const InputScript& script, const std::atomic<bool>* cancel)
+{
+    //Count this run so 'stopAll()' can wait for it (until the very end, since the display is used right up to the return)
+    struct RunGuard {
+        RunGuard()  { std::lock_guard<std::mutex> lock(runsMtx); numRuns++; }
+        ~RunGuard() { std::lock_guard<std::mutex> lock(runsMtx); numRuns--; runsDone.notify_all(); }
+    } guard;
+
+    InputScriptReport res;
+    res.numEvents = script.events.size();
+    res.plannedMS = script.durationMS;
+    res.errorsUS.reserve(script.events.size());
+
+    int64_t t0 = nowNS();
+    for(size_t i = 0; i<script.events.size(); i++) {
+        if(isCancelled(cancel)) break;
+
+        //Sleep in slices while far from the deadline, so cancelling doesn't wait for long pauses to end
+        const InputEvent& ev = script.events[i];
+        int64_t deadline = t0+(int64_t)(ev.atMS*1000000.0);
+        while(deadline-nowNS()>cancelCheckNS && !isCancelled(cancel)) sleepUntilNS(nowNS()+cancelCheckNS);
+        if(isCancelled(cancel)) break;
+        sleepUntilNS(deadline);
+        int64_t t = nowNS();
+        dispatch(ev);
+
+        double errUS = (t-deadline)/1000.0;
+        res.errorsUS.push_back(errUS);
+        res.meanAbsErrorUS += std::abs(errUS);
+        res.maxAbsErrorUS = std::max(res.maxAbsErrorUS, std::abs(errUS));
+        res.numCompleted++;
+    }
+    res.actualMS = (nowNS()-t0)/1000000.0;
+    if(res.numCompleted>0) res.meanAbsErrorUS /= res.numCompleted;
+
+    //Don't leave a keysym bound to the scratch key once the script is over (after measuring, so the report isn't skewed)
+    XKeymap::flushScratchKey(XNativeInput::getDisplay(), true);
+    return res;
+}
+
+std::future<InputScriptReport> InputScheduler::start(const InputScript& script, const std::atomic<bool>* cancel)
+{
+    return std::async(std::launch::async, [script, cancel]() { return run(script, cancel); });
+}
+
+void InputScheduler::stopAll()
+{
+    std::unique_lock<std::mutex> lock(runsMtx);
+    stopping = true;
+    runsDone.wait(lock, []{ return numRuns==0; });
+    stopping = false;
+}
+
+int64_t InputScheduler::nowNS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec*1000000000LL+ts.tv_nsec;
+}
+void InputScheduler::sleepUntilNS(int64_t deadline)
+{
+    timespec ts;
+    ts.tv_sec = deadline/1000000000LL;
+    ts.tv_nsec = deadline%1000000000LL;
+    //clock_nanosleep() returns the error instead of setting errno. Only a signal interruption is worth retrying.
+    int err;
+    while((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))==EINTR) {}
+    if(err!=0) {
+        Log::errorv(__PRETTY_FUNCTION__, "clock_nanosleep()", "Failed with error %d (%s)", err, strerror(err));
+    }
+}
+
+bool InputScheduler::isCancelled(const std::atomic<bool>* cancel) {
+    return stopping || (cancel!=nullptr && cancel->load());
+}
+
+void InputScheduler::dispatch(const InputEvent& ev)
+{
+    std::stringstream cmd;
+    switch(ev.type) {
+        case InputEvent::KEY_DOWN: {
+            if(!XNativeInput::keyDown(ev.key)) cmd << "xdotool keydown " << ev.key;
+        } break;
+        case InputEvent::KEY_UP: {
+            if(!XNativeInput::keyUp(ev.key)) cmd << "xdotool keyup " << ev.key;
+        } break;
+        case InputEvent::KEYSYM_DOWN:
+        case InputEvent::KEYSYM_UP: {
+            bool down = ev.type==InputEvent::KEYSYM_DOWN;
+            if(down ? XNativeInput::keysymDown(ev.keysym) : XNativeInput::keysymUp(ev.keysym)) break;
+            const char* name = XKeysymToString(ev.keysym);
+            if(name!=nullptr) cmd << (down ? "xdotool keydown " : "xdotool keyup ") << name;
+        } break;
+        case InputEvent::MOUSE_MOVE: {
+            if(!XNativeInput::moveMouse(ev.x, ev.y)) cmd << "xdotool mousemove " << ev.x << " " << ev.y;
+        } break;
+        case InputEvent::MOUSE_DOWN: {
+            if(!XNativeInput::mouseButton(ev.btn, true)) cmd << "xdotool mousedown " << ev.btn;
+        } break;
+        case InputEvent::MOUSE_UP: {
+            if(!XNativeInput::mouseButton(ev.btn, false)) cmd << "xdotool mouseup " << ev.btn;
+        } break;
+        case InputEvent::WAIT: break;
+    }
+    if(cmd.str()!="") Shell::exec(cmd.str());
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nch {
+/// @brief Returns a delay in milliseconds, drawn from the given random engine.
+typedef std::function<double(std::mt19937_64&)> DelayDistribution;
+
+/// @brief A single timed input action. 'atMS' is the planned time relative to the start of the script.
+struct InputEvent {
+    enum Type { KEY_DOWN, KEY_UP, KEYSYM_DOWN, KEYSYM_UP, MOUSE_MOVE, MOUSE_DOWN, MOUSE_UP, WAIT };
+    Type type = WAIT;
+    std::string key;        //xdotool-style key sequence for KEY_DOWN/KEY_UP (ex: "a", "ctrl+v")
+    unsigned long keysym = 0;   //X11 keysym for KEYSYM_DOWN/KEYSYM_UP (see XKeymap::unicodeToKeysym())
+    int x = 0; int y = 0;   //Absolute position for MOUSE_MOVE
+    int btn = 1;            //Button for MOUSE_DOWN/MOUSE_UP
+    double atMS = 0;
+};
+
+/// @brief Achieved-versus-planned timing of a script run by InputScheduler.
+struct InputScriptReport {
+    size_t numEvents = 0;
+    size_t numCompleted = 0;    //Less than 'numEvents' if the run was cancelled
+    double plannedMS = 0;
+    double actualMS = 0;
+    double meanAbsErrorUS = 0;
+    double maxAbsErrorUS = 0;
+    std::vector<double> errorsUS;   //Actual minus planned dispatch time of each completed event
+};
+
+/// @brief A batch of timed input events. Each builder call schedules its event 'afterMS' after the previous one.
+class InputScript {
+public:
+    InputScript& keyDown(const std::string& key, double afterMS = 0);
+    InputScript& keyUp(const std::string& key, double afterMS = 0);
+    InputScript& keysymDown(unsigned long keysym, double afterMS = 0);
+    InputScript& keysymUp(unsigned long keysym, double afterMS = 0);
+    InputScript& mouseMove(int x, int y, double afterMS = 0);
+    InputScript& mouseDown(int btn, double afterMS = 0);
+    InputScript& mouseUp(int btn, double afterMS = 0);
+    InputScript& wait(double ms);
+
+    /// @brief Build the key down/up events needed to type the UTF-8 'text'. Characters are turned into keysyms up front (see XKeymap),
+    /// @brief so no strings are built while typing, and characters missing from the keyboard layout can be typed too.
+    /// @param seed Seed for the delay distributions. The same seed always yields the same delays.
+    /// @param keyDownDist How long each key is held down.
+    /// @param keyUpDist How long to wait after each key is released.
+    static InputScript typing(const std::string& text, uint64_t seed, DelayDistribution keyDownDist, DelayDistribution keyUpDist);
+    static InputScript typing(const std::string& text, uint64_t seed);
+
+    /// @return A distribution returning a uniformly random delay within [minMS, maxMS).
+    static DelayDistribution uniformDelay(double minMS, double maxMS);
+    /// @return A distribution returning a normally distributed delay, never below 'minMS'.
+    static DelayDistribution normalDelay(double meanMS, double stddevMS, double minMS);
+
+    std::vector<InputEvent> events;
+    double durationMS = 0;
+private:
+    InputScript& add(InputEvent ev, double afterMS);
+};
+
+class InputScheduler {
+public:
+    /// @brief Execute 'script' on the calling thread. Every event is dispatched at its absolute deadline (clock_nanosleep on CLOCK_MONOTONIC),
+    /// @brief so delays never accumulate drift from the time spent sending previous events.
+    /// @param cancel If not nullptr, the run stops early once '*cancel' becomes true (or 'stopAll()' is called).
+    /// @return Timing statistics of the run.
+    static InputScriptReport run(const InputScript& script, const std::atomic<bool>* cancel = nullptr);
+    /// @brief Same as 'run()', but on a dedicated thread.
+    static std::future<InputScriptReport> start(const InputScript& script, const std::atomic<bool>* cancel = nullptr);
+    /// @brief Cancel every run in progress (from 'run()' or 'start()') and block until they have all returned. Called by Xcalibur::free().
+    static void stopAll();
+    /// @brief Send a single event right now (natively if possible, with xdotool otherwise).
+    static void dispatch(const InputEvent& ev);
+
+    /// @return The current CLOCK_MONOTONIC time in nanoseconds.
+    static int64_t nowNS();
+    /// @brief Sleep until the absolute CLOCK_MONOTONIC time 'deadline' (nanoseconds).
+    static void sleepUntilNS(int64_t deadline);
+private:
+    static bool isCancelled(const std::atomic<bool>* cancel);
+
+    static const int64_t cancelCheckNS = 10000000;     //Longest sleep between two checks for cancellation
+
+    static std::mutex runsMtx;
+    static std::condition_variable runsDone;
+    static int numRuns;                 //Guarded by 'runsMtx'
+    static std::atomic<bool> stopping;
+}; }
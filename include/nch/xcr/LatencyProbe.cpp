@@ -0,0 +1,109 @@
+#include "LatencyProbe.h"
+#include <algorithm>
+#include <cmath>
+#include <nch/cpp-utils/log.h>
+#include <nch/cpp-utils/timer.h>
+#include <sstream>
+#include "Xcalibur.h"
+
+using namespace nch;
+
+bool LatencyProbe::measureOnce(const std::function<void()>& inject, const Rect& roi, int timeoutMS, double& latencyMS, double* sampleIntervalMS)
+{
+    std::vector<uint32_t> before, current;
+    if(!Xcalibur::captureDisplayArea(roi, before)) return false;
+
+    int64_t t0 = InputScheduler::nowNS();
+    int64_t deadline = t0+(int64_t)timeoutMS*1000000LL;
+    inject();
+
+    //Sample as fast as the capture allows - there is no sleep, the XShm round-trip paces the loop
+    int64_t tFirst = InputScheduler::nowNS(), tNow = tFirst;
+    uint64_t numSamples = 0;
+    bool changed = false;
+    while(tNow<deadline) {
+        if(!Xcalibur::captureDisplayArea(roi, current)) return false;
+        tNow = InputScheduler::nowNS();
+        numSamples++;
+        if(current!=before) { changed = true; break; }
+    }
+
+    if(sampleIntervalMS!=nullptr) {
+        *sampleIntervalMS = numSamples>0 ? (tNow-tFirst)/1000000.0/numSamples : 0;
+    }
+    latencyMS = (tNow-t0)/1000000.0;
+    return changed;
+}
+
+LatencyStats LatencyProbe::measure(const std::function<void()>& inject, const LatencyProbeOptions& opts)
+{
+    std::vector<double> samples;
+    int numTimeouts = 0;
+    double intervalSum = 0;
+    int numIntervals = 0;
+
+    for(int i = 0; i<opts.numTrials; i++) {
+        double latency = 0, interval = 0;
+        if(measureOnce(inject, opts.roi, opts.timeoutMS, latency, &interval)) {
+            samples.push_back(latency);
+        } else {
+            numTimeouts++;
+        }
+        if(interval>0) { intervalSum += interval; numIntervals++; }
+        Timer::sleep(opts.settleMS);
+    }
+
+    LatencyStats res = computeStats(samples, numTimeouts);
+    res.meanSampleIntervalMS = numIntervals>0 ? intervalSum/numIntervals : 0;
+    return res;
+}
+
+LatencyStats LatencyProbe::measure(const std::vector<InputEvent>& events, const LatencyProbeOptions& opts)
+{
+    return measure([&events]() {
+        for(int i = 0; i<events.size(); i++) InputScheduler::dispatch(events[i]);
+    }, opts);
+}
+
+LatencyStats LatencyProbe::computeStats(const std::vector<double>& samplesMS, int numTimeouts)
+{
+    LatencyStats res;
+    res.numTrials = samplesMS.size()+numTimeouts;
+    res.numTimeouts = numTimeouts;
+    res.samplesMS = samplesMS;
+    if(samplesMS.empty()) return res;
+
+    std::vector<double> sorted = samplesMS;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    auto percentile = [&](double p) -> double {
+        size_t rank = (size_t)std::ceil(p/100.0*n);
+        return sorted[std::min(n, std::max<size_t>(rank, 1))-1];
+    };
+
+    double sum = 0;
+    for(size_t i = 0; i<n; i++) sum += sorted[i];
+    res.meanMS = sum/n;
+    double sqSum = 0;
+    for(size_t i = 0; i<n; i++) sqSum += (sorted[i]-res.meanMS)*(sorted[i]-res.meanMS);
+    res.stddevMS = std::sqrt(sqSum/n);
+
+    res.minMS = sorted.front();
+    res.maxMS = sorted.back();
+    res.medianMS = percentile(50);
+    res.p90MS = percentile(90);
+    res.p99MS = percentile(99);
+    return res;
+}
+
+std::string LatencyProbe::toString(const LatencyStats& stats)
+{
+    std::stringstream ss;
+    ss.precision(3);
+    ss << std::fixed;
+    ss << (stats.numTrials-stats.numTimeouts) << "/" << stats.numTrials << " trials responded: ";
+    ss << "min=" << stats.minMS << "ms median=" << stats.medianMS << "ms mean=" << stats.meanMS << "ms ";
+    ss << "p90=" << stats.p90MS << "ms p99=" << stats.p99MS << "ms max=" << stats.maxMS << "ms ";
+    ss << "stddev=" << stats.stddevMS << "ms (sampled every " << stats.meanSampleIntervalMS << "ms)";
+    return ss.str();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <functional>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include <vector>
+#include "InputScheduler.h"
+
+namespace nch {
+struct LatencyProbeOptions {
+    nch::Rect roi = nch::Rect(0, 0, 0, 0);  //Area of Xcalibur's display expected to change in response to the input
+    int numTrials = 20;
+    int timeoutMS = 1000;       //A trial without any change in 'roi' after this long counts as a timeout
+    int settleMS = 250;         //Wait between trials so the target is idle again (and 'roi' is re-read) before the next injection
+};
+
+/// @brief Latency distribution over several trials, in milliseconds. Percentiles are nearest-rank.
+struct LatencyStats {
+    int numTrials = 0;
+    int numTimeouts = 0;
+    std::vector<double> samplesMS;      //Latency of every trial that didn't time out, in trial order
+    double minMS = 0, meanMS = 0, medianMS = 0, p90MS = 0, p99MS = 0, maxMS = 0, stddevMS = 0;
+    double meanSampleIntervalMS = 0;    //Average time between two captures of 'roi' (the resolution of the measurements)
+};
+
+class LatencyProbe {
+public:
+    /// @brief Measure how long the target takes to visibly respond to one injected input.
+    /// @brief 'roi' is grabbed once, 'inject' is called, then 'roi' is grabbed back-to-back (Xcalibur::captureDisplayArea()) until any pixel differs.
+    /// @param latencyMS Receives the time from just before 'inject' to the end of the first capture showing the change (CLOCK_MONOTONIC, sub-millisecond).
+    /// @param sampleIntervalMS If not nullptr, receives the average time between two captures.
+    /// @return False on timeout (or if Xcalibur isn't initialized).
+    static bool measureOnce(const std::function<void()>& inject, const nch::Rect& roi, int timeoutMS, double& latencyMS, double* sampleIntervalMS = nullptr);
+    /// @brief Repeat 'measureOnce()' 'opts.numTrials' times and summarize the results.
+    static LatencyStats measure(const std::function<void()>& inject, const LatencyProbeOptions& opts);
+    /// @brief Same as above, injecting 'ev' with InputScheduler::dispatch() (ex: a MOUSE_DOWN, or a KEY_DOWN followed by its KEY_UP).
+    /// @param events Events sent back-to-back on every trial. The latency is measured from the first one.
+    static LatencyStats measure(const std::vector<InputEvent>& events, const LatencyProbeOptions& opts);
+
+    /// @brief Compute min/mean/percentiles/max/stddev of 'samplesMS'.
+    static LatencyStats computeStats(const std::vector<double>& samplesMS, int numTimeouts);
+    /// @return A one-line human readable summary of 'stats'.
+    static std::string toString(const LatencyStats& stats);
+}; }
@@ -3,12 +3,16 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QGuiApplication>
+#include <algorithm>
 #include <assert.h>
 #include <libclipboard/libclipboard.h>
 #include <nch/cpp-utils/file-utils.h>
 #include <nch/cpp-utils/shell.h>
 #include <nch/cpp-utils/string-utils.h>
 #include <nch/cpp-utils/log.h>
+#include "OCRAtlas.h"
+#include "OCREngine.h"
+#include "OCRWorkerPool.h"
 #include "Xcalibur.h"
 
 using namespace nch;
@@ -29,6 +33,9 @@ void MiscTools::globalFreeLibclipboard()
     clipboard_free(cb);
     cb = nullptr;
 }
+bool MiscTools::isLibclipboardOpen() {
+    return cb!=nullptr;
+}
 
 std::string MiscTools::qtGetClipboard()
 {
@@ -63,8 +70,8 @@ std::wstring MiscTools::qtGetClipboardW()
 void MiscTools::lcSetClipboard(const std::string& clipboardText)
 {
     if(cb==nullptr) {
-        nch::Log::warn(__PRETTY_FUNCTION__, "Clipboard is not open");
-        return;
+        globalInitLibclipboard();
+        if(cb==nullptr) return;
     }
 
     if(clipboardText=="") {
@@ -80,18 +87,14 @@ void MiscTools::lcSetClipboard(const std::string& clipboardText)
     
 }
 
-std::string MiscTools::sdlSurfOCR(SDL_Surface* surf, std::string extraArgs)
-{
-    //Save image, use Tesseract OCR on file, return result.
-    IMG_SavePNG(surf, "temp_ocr_screencap.png");
-    std::string ocr;
-    if(extraArgs=="") { ocr = Shell::exec("tesseract temp_ocr_screencap.png stdout"); }
-    else              { ocr = Shell::exec("tesseract temp_ocr_screencap.png stdout "+extraArgs); }
-    return ocr;
+std::string MiscTools::sdlSurfOCR(SDL_Surface* surf, std::string extraArgs) {
+    return sdlSurfOCR(surf, OCROptions::fromArgs(extraArgs));
+}
+std::string MiscTools::sdlSurfOCR(SDL_Surface* surf, const OCROptions& opts) {
+    return OCREngine::recognize(surf, opts);
 }
-
 std::string MiscTools::sdlSurfOCR(SDL_Surface* surf) {
-    return sdlSurfOCR(surf, "");
+    return sdlSurfOCR(surf, OCROptions());
 }
 
 std::string MiscTools::sdlTexOCR(SDL_Texture* tex, SDL_Renderer* rend)
@@ -110,16 +113,88 @@ std::string MiscTools::sdlTexOCR(SDL_Texture* tex, SDL_Renderer* rend)
     return res;
 }
 
-std::string MiscTools::displayOCR(const Rect& area, std::string extraArgs)
+std::string MiscTools::displayOCR(const Rect& area, std::string extraArgs) {
+    return displayOCR(area, OCROptions::fromArgs(extraArgs));
+}
+std::string MiscTools::displayOCR(const Rect& area, const OCROptions& opts)
 {
-    auto surf = Xcalibur::displayToSDLSurf(area);
-    std::string ocr = StringUtils::trimmed(MiscTools::sdlSurfOCR(surf, extraArgs));
-    SDL_FreeSurface(surf);
-    return ocr;
+    //OCR straight from the captured frame: no intermediate SDL_Surface
+    const uint8_t* pixels; int w, h, pitch;
+    if(!getDisplayPixels(area, pixels, w, h, pitch)) return "";
+    return StringUtils::trimmed(OCREngine::recognize(pixels, w, h, pitch, opts));
 }
 std::string MiscTools::displayOCR(const Rect& area) {
-    return displayOCR(area, "");
+    return displayOCR(area, OCROptions());
+}
+std::vector<std::string> MiscTools::batchOCR(const std::vector<Rect>& areas, const OCROptions& opts)
+{
+    std::vector<std::string> res(areas.size());
+    if(areas.empty()) return res;
+
+    //Capture once, then copy every area out so that workers don't depend on 'screenSurf' staying untouched
+    Xcalibur::updateScreenSurf();
+    SDL_Surface* surf = Xcalibur::getCapturedScreenSurf();
+    if(surf==nullptr) return res;
+
+    std::vector<std::future<std::string>> futures(areas.size());
+    for(size_t i = 0; i<areas.size(); i++) {
+        int x0 = std::max(areas[i].r.x, 0), x1 = std::min(areas[i].r.x+areas[i].r.w, surf->w);
+        int y0 = std::max(areas[i].r.y, 0), y1 = std::min(areas[i].r.y+areas[i].r.h, surf->h);
+        if(x1<=x0 || y1<=y0) continue;
+
+        int w = x1-x0, h = y1-y0;
+        std::shared_ptr<std::vector<uint8_t>> pixels = std::make_shared<std::vector<uint8_t>>((size_t)w*h*4);
+        for(int y = 0; y<h; y++) {
+            memcpy(pixels->data()+(size_t)y*w*4, (const uint8_t*)surf->pixels+(size_t)(y0+y)*surf->pitch+x0*4, w*4);
+        }
+        futures[i] = OCRWorkerPool::submit([pixels, w, h, opts]() {
+            return StringUtils::trimmed(OCREngine::recognize(pixels->data(), w, h, w*4, opts));
+        });
+    }
+
+    for(size_t i = 0; i<futures.size(); i++) {
+        if(futures[i].valid()) res[i] = futures[i].get();
+    }
+    return res;
+}
+std::vector<std::string> MiscTools::batchOCR(const std::vector<Rect>& areas) {
+    return batchOCR(areas, OCROptions());
+}
+
+GlyphReadResult MiscTools::displayGlyphRead(const Rect& area, const BitmapFont& font, const GlyphReadOptions& opts)
+{
+    const uint8_t* pixels; int w, h, pitch;
+    if(!getDisplayPixels(area, pixels, w, h, pitch)) return GlyphReadResult();
+
+    GlyphReadResult res = font.read(pixels, w, h, pitch, opts);
+    for(size_t i = 0; i<res.boxes.size(); i++) {
+        res.boxes[i].r.x += std::max(area.r.x, 0);
+        res.boxes[i].r.y += std::max(area.r.y, 0);
+    }
+    return res;
+}
+GlyphReadResult MiscTools::displayGlyphRead(const Rect& area, const BitmapFont& font) {
+    return displayGlyphRead(area, font, GlyphReadOptions());
+}
+
+std::vector<OCRIndex> MiscTools::displayAtlasOCR(const std::vector<Rect>& areas, const OCROptions& opts)
+{
+    Xcalibur::updateScreenSurf();
+    SDL_Surface* surf = Xcalibur::getCapturedScreenSurf();
+    if(surf==nullptr) return std::vector<OCRIndex>(areas.size());
+    return OCRAtlas::recognize((const uint8_t*)surf->pixels, surf->w, surf->h, surf->pitch, areas, opts);
 }
+std::vector<OCRIndex> MiscTools::displayAtlasOCR(const std::vector<Rect>& areas) {
+    return displayAtlasOCR(areas, OCROptions());
+}
+
+OCRIndex MiscTools::displayOCRIndex(const Rect& area, const OCROptions& opts)
+{
+    const uint8_t* pixels; int w, h, pitch;
+    if(!getDisplayPixels(area, pixels, w, h, pitch)) return OCRIndex();
+    return OCRIndex::fromTSV(OCREngine::recognizeTSV(pixels, w, h, pitch, opts), Vec2i(std::max(area.r.x, 0), std::max(area.r.y, 0)));
+}
+OCRIndex MiscTools::displayOCRIndex(const Rect& area) { return displayOCRIndex(area, OCROptions()); }
 
 std::vector<Rect> MiscTools::displayFindTextboxes(const Rect& displayArea, std::string textToFind)
 {
@@ -137,16 +212,12 @@ std::vector<Rect> MiscTools::displayFindTextboxes(const Rect& displayArea, std::
 
     /* Get the contents of the .box file generated from Tesseract's OCR */
     std::vector<std::string> fileLines;
+    int imgH = 0;
     {
-        //Generate image from 'displayArea'
-        auto surf = Xcalibur::displayToSDLSurf(displayArea);
-        IMG_SavePNG(surf, "temp_textbox_screencap.png");
-        SDL_FreeSurface(surf);
-        //Perform OCR on image and get the conents of the .box file
-        Shell::exec("tesseract temp_textbox_screencap.png temp_textbox_screencap makebox");
-        FILE* fp = fopen("temp_textbox_screencap.box", "r");
-        fileLines = FileUtils::getFileLines(fp);    
-        fclose(fp);
+        //Perform OCR on the captured frame and get the contents of the .box file
+        const uint8_t* pixels; int w, pitch;
+        if(!getDisplayPixels(displayArea, pixels, w, imgH, pitch)) return {};
+        fileLines = StringUtils::split(OCREngine::recognizeBoxes(pixels, w, imgH, pitch, OCROptions()), '\n');
     }
 
     //Get a list of all characters detected by the OCR (left -> right, top -> bottom order)
@@ -180,7 +251,7 @@ std::vector<Rect> MiscTools::displayFindTextboxes(const Rect& displayArea, std::
         }
 
         Rect textboxModded = textbox;
-        textboxModded.r.y = displayArea.r.h-textbox.r.y-textbox.r.h;
+        textboxModded.r.y = imgH-textbox.r.y-textbox.r.h;
         textbox = textboxModded;
 
         res.push_back(textbox);
@@ -188,4 +259,56 @@ std::vector<Rect> MiscTools::displayFindTextboxes(const Rect& displayArea, std::
 
     //Return
     return res;
+}
+
+std::vector<Rect> MiscTools::displayFindWordboxes(const Rect& displayArea, const std::string& textToFind)
+{
+    /* Input checking */
+    if(textToFind.size()==0) return {};
+
+    /* OCR the area into a word index (boxes relative to 'displayArea') and search it */
+    const uint8_t* pixels; int w, h, pitch;
+    if(!getDisplayPixels(displayArea, pixels, w, h, pitch)) return {};
+    OCRIndex index = OCRIndex::fromTSV(OCREngine::recognizeTSV(pixels, w, h, pitch, OCROptions()));
+
+    std::vector<Rect> res;
+    std::vector<OCRMatch> matches = index.find(textToFind);
+    for(size_t i = 0; i<matches.size(); i++) res.push_back(matches[i].box);
+    return res;
+}
+
+std::vector<std::vector<Rect>> MiscTools::displayFindWordboxes(const std::vector<Rect>& areas, const std::string& textToFind)
+{
+    std::vector<std::vector<Rect>> res(areas.size());
+    if(textToFind.size()==0) return res;
+
+    std::vector<OCRIndex> indices = displayAtlasOCR(areas);
+    for(size_t i = 0; i<areas.size(); i++) {
+        std::vector<OCRMatch> matches = indices[i].find(textToFind);
+        for(size_t j = 0; j<matches.size(); j++) {
+            Rect box = matches[j].box;
+            box.r.x -= std::max(areas[i].r.x, 0);
+            box.r.y -= std::max(areas[i].r.y, 0);
+            res[i].push_back(box);
+        }
+    }
+    return res;
+}
+
+bool MiscTools::getDisplayPixels(const Rect& area, const uint8_t*& pixels, int& w, int& h, int& pitch)
+{
+    Xcalibur::updateScreenSurf();
+    SDL_Surface* surf = Xcalibur::getCapturedScreenSurf();
+    if(surf==nullptr) return false;
+
+    int x0 = std::max(area.r.x, 0), x1 = std::min(area.r.x+area.r.w, surf->w);
+    int y0 = std::max(area.r.y, 0), y1 = std::min(area.r.y+area.r.h, surf->h);
+    if(x1<=x0 || y1<=y0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "'area' doesn't overlap the captured area");
+        return false;
+    }
+    w = x1-x0; h = y1-y0;
+    pitch = surf->pitch;
+    pixels = (const uint8_t*)surf->pixels+(size_t)y0*surf->pitch+x0*4;
+    return true;
 }
\ No newline at end of file
@@ -3,20 +3,28 @@
 #include <nch/sdl-utils/rect.h>
 #include <string>
 #include <vector>
+#include "BitmapFont.h"
+#include "OCRAtlas.h"
+#include "OCREngine.h"
+#include "OCRIndex.h"
 
 namespace nch { class MiscTools {
 public:
     static void globalInitLibclipboard();
     static void globalFreeLibclipboard();
+    static bool isLibclipboardOpen();
     static std::string qtGetClipboard();
     static std::wstring qtGetClipboardW();
+    /// @brief Set the clipboard's text using libclipboard. Opens the libclipboard connection first if needed.
     static void lcSetClipboard(const std::string& clipboardText);
 
     /// @brief Quickly save a SDL_Surface* to disk, perform Tesseract OCR on it, and return the result. You may want to trim the result using StringUtils::trimmed().
     /// @param surf The SDL_Surface* object to perform OCR on.
     /// @param extraArgs If not "": extra arguments to use for the 'tesseract' command (ex: "--psm 6").
     /// @return The OCR-detected text found within 'surf', as a single string (may include newlines).
+    /// @brief Runs in-process when built with libtesseract (see OCREngine). 'extraArgs' that have no OCROptions field force the 'tesseract' CLI.
     static std::string sdlSurfOCR(SDL_Surface* surf, std::string extraArgs);
+    static std::string sdlSurfOCR(SDL_Surface* surf, const OCROptions& opts);
     static std::string sdlSurfOCR(SDL_Surface* surf);
     /// @brief Same as 'sdlSurfOCR' but with an SDL_Texture*.
     /// @param tex The SDL_Texture* object to perform OCR on.
@@ -29,14 +37,45 @@ public:
     /// @param extraArgs See extraArgs from 'sdlSurfOCR'
     /// @return The OCR-detected text found within the specified 'area' of the Xcalibur display.
     static std::string displayOCR(const Rect& area, std::string extraArgs);
+    static std::string displayOCR(const Rect& area, const OCROptions& opts);
     static std::string displayOCR(const Rect& area);
+    /// @brief Perform OCR on many areas of the Xcalibur display at once, in parallel on OCRWorkerPool's threads.
+    /// @brief All areas are read from the same captured frame. Each result is trimmed like 'displayOCR()'.
+    /// @param areas The areas of the display to perform OCR on.
+    /// @return The OCR-detected text of every area, in the same order as 'areas' ("" for areas outside the display).
+    static std::vector<std::string> batchOCR(const std::vector<Rect>& areas, const OCROptions& opts);
+    static std::vector<std::string> batchOCR(const std::vector<Rect>& areas);
 
+    /// @brief Read a line of text in a known UI font (see BitmapFont) from the Xcalibur display, without Tesseract unless 'opts.ocrFallback' kicks in.
+    /// @param area The area of the display containing the text.
+    /// @return The text, with per-character confidences and boxes in display coordinates.
+    static GlyphReadResult displayGlyphRead(const Rect& area, const BitmapFont& font, const GlyphReadOptions& opts);
+    static GlyphReadResult displayGlyphRead(const Rect& area, const BitmapFont& font);
+    /// @brief Perform OCR on many (small) areas of the Xcalibur display with a single recognition call, by packing them into one atlas (see OCRAtlas).
+    /// @brief Cheaper than 'batchOCR()' when reading dozens of short labels per frame, since Tesseract's per-call overhead is only paid once.
+    /// @param areas The areas of the display to perform OCR on.
+    /// @return One index per area, in the same order as 'areas', with boxes in display coordinates.
+    static std::vector<OCRIndex> displayAtlasOCR(const std::vector<Rect>& areas, const OCROptions& opts);
+    static std::vector<OCRIndex> displayAtlasOCR(const std::vector<Rect>& areas);
+    /// @brief Perform OCR on the Xcalibur display once and index every word and line it contains (with boxes and confidences).
+    /// @brief The index can then answer any number of searches (exact, case-insensitive or fuzzy) without running OCR again.
+    /// @param area The area of the display to perform OCR on.
+    /// @return The index, with boxes in display coordinates. Empty if 'area' is outside the display or OCR failed.
+    static OCRIndex displayOCRIndex(const Rect& area, const OCROptions& opts);
+    static OCRIndex displayOCRIndex(const Rect& area);
     /// @brief Use Tesseract's OCR on the Xcalibur display and attempt to return the bounding boxes of a given piece of text.
     /// @param area The area of the display to perform OCR on.
     /// @param textToFind The text to find within the 'area' specified.
     /// @return A list of rectangles containing the occurrences of 'textToFind' in absolute coordinates ((0, 0) being @ (x, y) within Xcalibur::init(x, y, w, h)).
     /// @return If the OCR could not find the provided 'textToFind', return Rect(-1, -1, 0, 0).
     static std::vector<Rect> displayFindTextboxes(const Rect& area, std::string textToFind);
+    /// @brief Like 'displayFindTextboxes()', but searches a word index (see 'displayOCRIndex()'): boxes cover whole words, matches stay within a line and don't overlap.
+    /// @brief To look for several pieces of text in the same area (or fuzzy matches), use 'displayOCRIndex()' once and search the index instead.
+    /// @return The boxes of every occurrence of 'textToFind', relative to 'area'.
+    static std::vector<Rect> displayFindWordboxes(const Rect& area, const std::string& textToFind);
+    /// @brief Same as above for many areas at once, read with a single OCR call (see 'displayAtlasOCR()').
+    /// @return The boxes found within each area (relative to that area, like above), in the same order as 'areas'.
+    static std::vector<std::vector<Rect>> displayFindWordboxes(const std::vector<Rect>& areas, const std::string& textToFind);
 private:
-
+    static bool getDisplayPixels(const Rect& area, const uint8_t*& pixels, int& w, int& h, int& pitch);
 }; }
\ No newline at end of file
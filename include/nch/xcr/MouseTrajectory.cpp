@@ -0,0 +1,177 @@
+#include "MouseTrajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "InputScheduler.h"
+#include "XTools.h"
+
+using namespace nch;
+
+std::mutex MouseTrajectory::runsMtx;
+std::condition_variable MouseTrajectory::runsDone;
+int MouseTrajectory::numRuns = 0;
+std::atomic<bool> MouseTrajectory::stopping(false);
+
+MouseTrajectory::MouseTrajectory(): cancelled(false), moving(false) {}
+MouseTrajectory::~MouseTrajectory()
+{
+    cancel();
+    if(thread.joinable()) thread.join();
+}
+
+std::vector<Vec2d> MouseTrajectory::generatePath(const Vec2d& from, const Vec2d& to, const TrajectoryOptions& opts)
+{
+    std::vector<Vec2d> res;
+    std::mt19937_64 rng(opts.seed);
+    std::uniform_real_distribution<double> bowDist(-1.0, 1.0);
+    std::normal_distribution<double> jitterDist(0.0, std::max(opts.jitterPx, 1e-9));
+
+    double dx = to.x-from.x, dy = to.y-from.y;
+    double dist = std::sqrt(dx*dx+dy*dy);
+
+    //Pick duration from distance if not specified
+    double durationMS = opts.durationMS;
+    if(durationMS<=0) durationMS = 80+90*std::log2(1+dist/10.0);
+    int rateHz = std::max(1, opts.rateHz);
+    int numPts = std::max(2, (int)std::ceil(durationMS*rateHz/1000.0)+1);
+
+    //Cubic Bezier control points, pushed sideways (perpendicular to the motion) by a random amount
+    Vec2d n(0, 0);
+    if(dist>0) n = Vec2d(-dy/dist, dx/dist);
+    double bow1 = opts.curvature*dist*bowDist(rng);
+    double bow2 = opts.curvature*dist*bowDist(rng)*0.5;
+    Vec2d p0 = from, p3 = to;
+    Vec2d p1(from.x+dx*0.3+n.x*bow1, from.y+dy*0.3+n.y*bow1);
+    Vec2d p2(from.x+dx*0.7+n.x*bow2, from.y+dy*0.7+n.y*bow2);
+
+    res.reserve(numPts);
+    for(int i = 0; i<numPts; i++) {
+        double t = i/(double)(numPts-1);
+        //Minimum-jerk time scaling
+        double s = t*t*t*(10+t*(-15+6*t));
+        double u = 1-s;
+        double x = u*u*u*p0.x + 3*u*u*s*p1.x + 3*u*s*s*p2.x + s*s*s*p3.x;
+        double y = u*u*u*p0.y + 3*u*u*s*p1.y + 3*u*s*s*p2.y + s*s*s*p3.y;
+        //Micro-jitter, none at the start and end
+        if(opts.jitterPx>0) {
+            double fade = std::sin(M_PI*t);
+            x += jitterDist(rng)*fade;
+            y += jitterDist(rng)*fade;
+        }
+        res.push_back(Vec2d(x, y));
+    }
+    res.back() = to;
+    return res;
+}
+
+void MouseTrajectory::start(const Vec2i& to, const TrajectoryOptions& opts)
+{
+    cancel();
+    if(thread.joinable()) thread.join();
+
+    Vec2i from = XTools::getMouseXY();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        target = to;
+        MouseTrajectory::opts = opts;
+        retargeted = false;
+        reached = false;
+    }
+    cancelled = false;
+    moving = true;
+    {
+        std::lock_guard<std::mutex> lock(runsMtx);
+        numRuns++;
+    }
+    thread = std::thread(&MouseTrajectory::run, this, Vec2d(from.x, from.y));
+}
+
+bool MouseTrajectory::retarget(const Vec2i& to)
+{
+    //'reached' is set under 'mtx' right before the motion thread stops looking at 'target'
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!moving || reached || cancelled) return false;
+    target = to;
+    retargeted = true;
+    return true;
+}
+
+void MouseTrajectory::cancel() {
+    cancelled = true;
+}
+
+bool MouseTrajectory::wait()
+{
+    if(thread.joinable()) thread.join();
+    std::lock_guard<std::mutex> lock(mtx);
+    return reached;
+}
+
+bool MouseTrajectory::isMoving() {
+    return moving;
+}
+
+void MouseTrajectory::moveTo(const Vec2i& to, const TrajectoryOptions& opts)
+{
+    MouseTrajectory mt;
+    mt.start(to, opts);
+    mt.wait();
+}
+
+void MouseTrajectory::cancelAll()
+{
+    std::unique_lock<std::mutex> lock(runsMtx);
+    stopping = true;
+    runsDone.wait(lock, []{ return numRuns==0; });
+    stopping = false;
+}
+
+void MouseTrajectory::run(Vec2d from)
+{
+    std::vector<Vec2d> path;
+    TrajectoryOptions o;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        o = opts;
+        path = generatePath(from, Vec2d(target.x, target.y), o);
+    }
+    int64_t periodNS = 1000000000LL/std::max(1, o.rateHz);
+    int64_t t0 = InputScheduler::nowNS();
+    Vec2i lastSent(-1, -1);
+
+    InputEvent ev;
+    ev.type = InputEvent::MOUSE_MOVE;
+    size_t i = 0;
+    while(!cancelled && !stopping) {
+        //Plan a new path from the current point if the target changed. Each retarget gets a fresh seed so paths don't repeat.
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if(retargeted) {
+                retargeted = false;
+                o.seed++;
+                o.durationMS = 0;
+                Vec2d cur = path[i>0 ? std::min(i, path.size())-1 : 0];
+                path = generatePath(cur, Vec2d(target.x, target.y), o);
+                t0 = InputScheduler::nowNS();
+                i = 0;
+            } else if(i>=path.size()) {
+                reached = true;
+                break;
+            }
+        }
+
+        InputScheduler::sleepUntilNS(t0+(int64_t)i*periodNS);
+        Vec2i p((int)std::lround(path[i].x), (int)std::lround(path[i].y));
+        if(p!=lastSent) {
+            ev.x = p.x; ev.y = p.y;
+            InputScheduler::dispatch(ev);
+            lastSent = p;
+        }
+        i++;
+    }
+    moving = false;
+
+    std::lock_guard<std::mutex> lock(runsMtx);
+    numRuns--;
+    runsDone.notify_all();
+}
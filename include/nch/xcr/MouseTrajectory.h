@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <nch/math-utils/vec2.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace nch {
+struct TrajectoryOptions {
+    double durationMS = 0;      //Total time of the motion. If 0, picked from the distance (Fitts' law-like).
+    int rateHz = 1000;          //Rate at which pointer motion events are sent (500-1000 is typical for real mice).
+    double curvature = 0.15;    //How far the path bows away from a straight line, as a fraction of the distance.
+    double jitterPx = 0.4;      //Standard deviation of the micro-jitter, faded out at both ends of the path.
+    uint64_t seed = 0;          //Seed for the curve shape and jitter. The same seed always yields the same path.
+};
+
+class MouseTrajectory {
+public:
+    MouseTrajectory();
+    ~MouseTrajectory();
+
+    /// @brief Generate a humanized path from 'from' to 'to': a cubic Bezier curve traversed with a minimum-jerk velocity profile
+    /// @brief (slow start, fast middle, slow end) plus micro-jitter. One point per 1/rateHz seconds; the last point is exactly 'to'.
+    static std::vector<nch::Vec2d> generatePath(const nch::Vec2d& from, const nch::Vec2d& to, const TrajectoryOptions& opts);
+
+    /// @brief Start moving the mouse from its current position to 'to' on a dedicated thread. Cancels any motion already in progress.
+    void start(const nch::Vec2i& to, const TrajectoryOptions& opts = TrajectoryOptions());
+    /// @brief Change the destination of the motion in progress. A new path is planned from wherever the pointer is right now.
+    /// @return False (and nothing moves) if there is no motion in progress: it already ended or was cancelled. Use 'start()' then.
+    bool retarget(const nch::Vec2i& to);
+    /// @brief Stop the motion in progress. The pointer stays wherever it currently is.
+    void cancel();
+    /// @brief Block until the motion in progress ends. @return True if the pointer reached its (latest) target, false if cancelled.
+    bool wait();
+    bool isMoving();
+
+    /// @brief Convenience: blocking move from the current mouse position to 'to'.
+    static void moveTo(const nch::Vec2i& to, const TrajectoryOptions& opts = TrajectoryOptions());
+    /// @brief Cancel the motion of every MouseTrajectory and block until their threads stop sending input. Called by Xcalibur::free().
+    static void cancelAll();
+private:
+    void run(nch::Vec2d from);
+
+    std::thread thread;
+    std::mutex mtx;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> moving;
+    bool retargeted = false;
+    bool reached = false;
+    nch::Vec2i target;
+    TrajectoryOptions opts;
+
+    static std::mutex runsMtx;
+    static std::condition_variable runsDone;
+    static int numRuns;                 //Motion threads still running, guarded by 'runsMtx'
+    static std::atomic<bool> stopping;
+}; }
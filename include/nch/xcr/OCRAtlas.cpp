@@ -0,0 +1,108 @@
+#include "OCRAtlas.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+using namespace nch;
+
+std::vector<OCRIndex> OCRAtlas::recognize(const uint8_t* pixels, int w, int h, int pitch, const std::vector<Rect>& areas, const OCROptions& opts, int padding)
+{
+    std::vector<OCRIndex> res(areas.size());
+    if(pixels==nullptr || areas.empty()) return res;
+
+    /* Clip every area to the image and pack them */
+    std::vector<Rect> clipped(areas.size());
+    std::vector<Vec2i> sizes(areas.size());
+    for(size_t i = 0; i<areas.size(); i++) {
+        int x0 = std::max(areas[i].r.x, 0), x1 = std::min(areas[i].r.x+areas[i].r.w, w);
+        int y0 = std::max(areas[i].r.y, 0), y1 = std::min(areas[i].r.y+areas[i].r.h, h);
+        clipped[i] = Rect(x0, y0, std::max(0, x1-x0), std::max(0, y1-y0));
+        sizes[i] = Vec2i(clipped[i].r.w, clipped[i].r.h);
+    }
+    OCRAtlasLayout layout = pack(sizes, std::max(0, padding));
+    if(layout.w==0) return res;
+
+    /* Build the atlas: white background, every area copied in as dark-on-light */
+    std::vector<uint32_t> atlas((size_t)layout.w*layout.h, 0xffffffff);
+    std::vector<uint8_t> gray;
+    for(size_t i = 0; i<areas.size(); i++) {
+        const Vec2i& pos = layout.positions[i];
+        if(pos.x<0) continue;
+        const Rect& c = clipped[i];
+        const uint8_t* src = pixels+(size_t)c.r.y*pitch+c.r.x*4;
+
+        gray.resize((size_t)c.r.w*c.r.h);
+        OCRPreprocess::toGray(src, c.r.w, c.r.h, pitch, gray.data());
+        uint64_t sum = 0;
+        for(size_t j = 0; j<gray.size(); j++) sum += gray[j];
+        bool dark = sum<(uint64_t)128*gray.size();
+
+        for(int y = 0; y<c.r.h; y++) {
+            uint32_t* dst = atlas.data()+(size_t)(pos.y+y)*layout.w+pos.x;
+            memcpy(dst, src+(size_t)y*pitch, c.r.w*4);
+            if(dark) for(int x = 0; x<c.r.w; x++) dst[x] ^= 0x00ffffff;
+        }
+    }
+
+    /* One OCR call for everything */
+    OCROptions atlasOpts = opts;
+    atlasOpts.preprocess.invert = 0;    //Already done per area
+    OCRIndex all = OCRIndex::fromTSV(OCREngine::recognizeTSV((const uint8_t*)atlas.data(), layout.w, layout.h, layout.w*4, atlasOpts));
+
+    /* Give every word back to the area containing its center, in image coordinates */
+    std::vector<int> lastLine(areas.size(), -1);
+    const std::vector<OCRWord>& words = all.getWords();
+    for(size_t j = 0; j<words.size(); j++) {
+        int cx = words[j].box.r.x+words[j].box.r.w/2, cy = words[j].box.r.y+words[j].box.r.h/2;
+        for(size_t i = 0; i<areas.size(); i++) {
+            const Vec2i& pos = layout.positions[i];
+            const Rect& c = clipped[i];
+            if(pos.x<0 || cx<pos.x || cy<pos.y || cx>=pos.x+c.r.w || cy>=pos.y+c.r.h) continue;
+
+            OCRWord word = words[j];
+            word.box.r.x += c.r.x-pos.x;
+            word.box.r.y += c.r.y-pos.y;
+            res[i].addWord(word, words[j].line!=lastLine[i]);
+            lastLine[i] = words[j].line;
+            break;
+        }
+    }
+    return res;
+}
+
+OCRAtlasLayout OCRAtlas::pack(const std::vector<Vec2i>& sizes, int padding)
+{
+    OCRAtlasLayout res;
+    res.positions.assign(sizes.size(), Vec2i(-1, -1));
+
+    //Aim for a square: Tesseract's cost grows with the atlas' area, so keep wasted space low
+    std::vector<size_t> order;
+    uint64_t totalArea = 0;
+    int widest = 0;
+    for(size_t i = 0; i<sizes.size(); i++) {
+        if(sizes[i].x<=0 || sizes[i].y<=0) continue;
+        order.push_back(i);
+        totalArea += (uint64_t)(sizes[i].x+padding)*(sizes[i].y+padding);
+        widest = std::max(widest, sizes[i].x);
+    }
+    if(order.empty()) return res;
+    int targetW = std::max(widest+2*padding, (int)std::ceil(std::sqrt((double)totalArea)));
+
+    //Shelves: tallest first, left to right, a new shelf whenever the current one is full
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a].y>sizes[b].y; });
+    int x = padding, y = padding, shelfH = 0;
+    for(size_t k = 0; k<order.size(); k++) {
+        const Vec2i& s = sizes[order[k]];
+        if(x>padding && x+s.x+padding>targetW) {
+            y += shelfH+padding;
+            x = padding;
+            shelfH = 0;
+        }
+        res.positions[order[k]] = Vec2i(x, y);
+        x += s.x+padding;
+        shelfH = std::max(shelfH, s.y);
+        res.w = std::max(res.w, x);
+    }
+    res.h = y+shelfH+padding;
+    return res;
+}
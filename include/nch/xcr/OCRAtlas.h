@@ -0,0 +1,32 @@
+#pragma once
+#include <nch/math-utils/vec2.h>
+#include <nch/sdl-utils/rect.h>
+#include <stdint.h>
+#include <vector>
+#include "OCREngine.h"
+#include "OCRIndex.h"
+
+namespace nch {
+/// @brief Where each region was placed within an atlas.
+struct OCRAtlasLayout {
+    int w = 0; int h = 0;               //Size of the atlas
+    std::vector<nch::Vec2i> positions;  //Top-left of each region within the atlas, (-1, -1) for empty regions
+};
+
+class OCRAtlas {
+public:
+    /// @brief Read many (small) areas of an image with a single OCR call: the areas are packed into one atlas image, separated by 'padding' pixels of blank space,
+    /// @brief and every recognized word is mapped back to the area it came from. This pays Tesseract's per-call setup once instead of once per area.
+    /// @brief Areas with a dark background are inverted while packing, so that every label in the atlas is dark-on-light.
+    /// @param pixels BGRA32 pixels of the whole image (ex: Xcalibur's 'screenSurf'), 'pitch' bytes per row.
+    /// @param areas The areas to read, in image coordinates. Parts outside the image are ignored.
+    /// @param opts OCR settings for the atlas. The default page segmentation (automatic) or 11 (sparse text) work best.
+    /// @param padding Blank pixels between areas - enough that Tesseract never joins words of neighboring areas.
+    /// @return One index per area (same order as 'areas'), with boxes in image coordinates.
+    static std::vector<OCRIndex> recognize(const uint8_t* pixels, int w, int h, int pitch, const std::vector<nch::Rect>& areas, const OCROptions& opts, int padding = 16);
+
+    /// @brief Pack rectangles of the given sizes on shelves (tallest first), aiming for a roughly square atlas.
+    /// @param sizes Width and height of every rectangle. Rectangles with no area are left out.
+    static OCRAtlasLayout pack(const std::vector<nch::Vec2i>& sizes, int padding);
+};
+}
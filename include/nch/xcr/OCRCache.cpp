@@ -0,0 +1,228 @@
+#include "OCRCache.h"
+#include <algorithm>
+#include <nch/cpp-utils/log.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace nch;
+
+std::mutex OCRCache::mtx;
+OCRCache::EntryList OCRCache::entries;
+std::unordered_map<uint64_t, OCRCache::EntryList::iterator> OCRCache::index;
+size_t OCRCache::capacity = 256;
+uint64_t OCRCache::numHits = 0;
+uint64_t OCRCache::numMisses = 0;
+std::string OCRCache::persistPath = "";
+int OCRCache::persistEvery = 16;
+int OCRCache::numUnsaved = 0;
+std::mutex OCRCache::saveMtx;
+uint64_t OCRCache::snapshotSeq = 0;
+uint64_t OCRCache::savedSeq = 0;
+
+namespace {
+    const char persistMagic[8] = { 'X', 'C', 'R', 'O', 'C', 'R', '1', '\n' };
+    inline uint64_t mix(uint64_t h, uint64_t v) {
+        h = (h^v)*0x9e3779b97f4a7c15ULL;
+        return h^(h>>29);
+    }
+}
+
+uint64_t OCRCache::makeKey(const uint8_t* pixels, int w, int h, int pitch, const std::string& args)
+{
+    uint64_t res = mix(mix(0xcbf29ce484222325ULL, (uint64_t)w), (uint64_t)h);
+
+    //Two pixels (alpha masked out) per step
+    for(int y = 0; y<h; y++) {
+        const uint8_t* row = pixels+(size_t)y*pitch;
+        int x = 0;
+        for(; x+1<w; x += 2) {
+            uint64_t v; memcpy(&v, row+4*x, 8);
+            res = mix(res, v&0x00ffffff00ffffffULL);
+        }
+        if(x<w) {
+            uint32_t v; memcpy(&v, row+4*x, 4);
+            res = mix(res, v&0x00ffffff);
+        }
+    }
+    for(size_t i = 0; i<args.size(); i++) res = mix(res, (uint8_t)args[i]);
+    return res;
+}
+
+bool OCRCache::get(uint64_t key, std::string& res)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto itr = index.find(key);
+    if(itr==index.end()) { numMisses++; return false; }
+
+    entries.splice(entries.begin(), entries, itr->second);
+    res = itr->second->second;
+    numHits++;
+    return true;
+}
+
+void OCRCache::putUnlocked(uint64_t key, const std::string& res)
+{
+    auto itr = index.find(key);
+    if(itr!=index.end()) {
+        itr->second->second = res;
+        entries.splice(entries.begin(), entries, itr->second);
+        return;
+    }
+    entries.push_front(std::make_pair(key, res));
+    index[key] = entries.begin();
+    evict();
+}
+
+void OCRCache::put(uint64_t key, const std::string& res)
+{
+    //Disk I/O happens outside 'mtx', so that other threads' get()s never wait for it
+    Snapshot snap;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(capacity==0) return;
+        bool added = index.find(key)==index.end();
+        putUnlocked(key, res);
+        if(!added || persistPath=="" || ++numUnsaved<persistEvery) return;
+        snap = takeSnapshot();
+    }
+    writeSnapshot(snap);
+}
+
+void OCRCache::setCapacity(size_t cap)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    capacity = cap;
+    evict();
+}
+size_t OCRCache::getSize()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return entries.size();
+}
+void OCRCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.clear();
+    index.clear();
+}
+
+uint64_t OCRCache::getNumHits()     { std::lock_guard<std::mutex> lock(mtx); return numHits; }
+uint64_t OCRCache::getNumMisses()   { std::lock_guard<std::mutex> lock(mtx); return numMisses; }
+void OCRCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    numHits = 0;
+    numMisses = 0;
+}
+
+void OCRCache::setPersistenceFile(const std::string& path, int saveEvery)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    persistPath = path;
+    persistEvery = std::max(1, saveEvery);
+    numUnsaved = 0;
+    if(persistPath!="") loadUnlocked();
+}
+
+bool OCRCache::save()
+{
+    Snapshot snap;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(persistPath=="") return false;
+        snap = takeSnapshot();
+    }
+    return writeSnapshot(snap);
+}
+
+void OCRCache::evict()
+{
+    while(entries.size()>capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+OCRCache::Snapshot OCRCache::takeSnapshot()
+{
+    Snapshot res;
+    res.path = persistPath;
+    res.seq = ++snapshotSeq;
+    //Least recently used first, so that loading re-creates the same order
+    res.entries.assign(entries.rbegin(), entries.rend());
+    numUnsaved = 0;
+    return res;
+}
+
+bool OCRCache::writeSnapshot(const Snapshot& snap)
+{
+    std::lock_guard<std::mutex> lock(saveMtx);
+    if(snap.seq<=savedSeq) return true;    //A newer snapshot was already written
+
+    //Write to a temporary file first, so that a crash never leaves a truncated cache behind
+    std::string tmpPath = snap.path+".tmp";
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if(fp==NULL) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Could not write \"%s\"", tmpPath.c_str());
+        return false;
+    }
+    fwrite(persistMagic, 1, sizeof(persistMagic), fp);
+    for(size_t i = 0; i<snap.entries.size(); i++) {
+        uint32_t len = snap.entries[i].second.size();
+        fwrite(&snap.entries[i].first, sizeof(uint64_t), 1, fp);
+        fwrite(&len, sizeof(uint32_t), 1, fp);
+        fwrite(snap.entries[i].second.data(), 1, len, fp);
+    }
+    bool ok = ferror(fp)==0;
+    fclose(fp);
+    if(!ok || rename(tmpPath.c_str(), snap.path.c_str())!=0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Could not save the cache to \"%s\"", snap.path.c_str());
+        remove(tmpPath.c_str());
+        return false;
+    }
+    savedSeq = snap.seq;
+    return true;
+}
+
+bool OCRCache::loadUnlocked()
+{
+    FILE* fp = fopen(persistPath.c_str(), "rb");
+    if(fp==NULL) return false;     //Nothing saved yet
+
+    char magic[sizeof(persistMagic)];
+    if(fread(magic, 1, sizeof(magic), fp)!=sizeof(magic) || memcmp(magic, persistMagic, sizeof(magic))!=0) {
+        Log::warnv(__PRETTY_FUNCTION__, "ignoring file", "\"%s\" is not an OCR cache file", persistPath.c_str());
+        fclose(fp);
+        return false;
+    }
+
+    //Every length is checked against what is left of the file: a corrupt length must not turn into a huge allocation
+    long start = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    uint64_t remaining = (uint64_t)(ftell(fp)-start);
+    fseek(fp, start, SEEK_SET);
+
+    std::vector<std::pair<uint64_t, std::string>> loaded;
+    bool corrupt = false;
+    uint64_t key; uint32_t len;
+    const uint64_t headerSize = sizeof(uint64_t)+sizeof(uint32_t);
+    while(remaining>0) {
+        if(remaining<headerSize || fread(&key, sizeof(uint64_t), 1, fp)!=1 || fread(&len, sizeof(uint32_t), 1, fp)!=1) { corrupt = true; break; }
+        remaining -= headerSize;
+        if(len>remaining) { corrupt = true; break; }
+
+        std::string value(len, '\0');
+        if(len>0 && fread(&value[0], 1, len, fp)!=len) { corrupt = true; break; }
+        remaining -= len;
+        loaded.push_back(std::make_pair(key, value));
+    }
+    fclose(fp);
+    if(corrupt) {
+        Log::warnv(__PRETTY_FUNCTION__, "deleting file", "\"%s\" is corrupt", persistPath.c_str());
+        remove(persistPath.c_str());
+        return false;
+    }
+
+    for(size_t i = 0; i<loaded.size(); i++) putUnlocked(loaded[i].first, loaded[i].second);
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nch { class OCRCache {
+public:
+    /// @brief Build the cache key of an OCR request: a hash of the image's contents (alpha ignored) and size, combined with 'args' (the OCR settings).
+    /// @param pixels BGRA32 pixels, 'pitch' bytes per row.
+    static uint64_t makeKey(const uint8_t* pixels, int w, int h, int pitch, const std::string& args);
+
+    /// @brief Look up a cached OCR result. A hit makes the entry the most recently used one.
+    /// @return True (hit) if 'key' is cached, false (miss) otherwise.
+    static bool get(uint64_t key, std::string& res);
+    /// @brief Cache an OCR result, evicting the least recently used entries beyond the capacity.
+    static void put(uint64_t key, const std::string& res);
+
+    /// @brief Set the maximum number of cached results (default: 256). 0 disables the cache.
+    static void setCapacity(size_t capacity);
+    static size_t getSize();
+    static void clear();
+
+    static uint64_t getNumHits();
+    static uint64_t getNumMisses();
+    static void resetStats();
+
+    /// @brief Load the cache from 'path' (if it exists) and keep it saved there: after every 'saveEvery' new entries and on 'save()'.
+    /// @brief The file is written without holding up lookups. A corrupt file is deleted instead of loaded.
+    /// @brief Pass "" to stop persisting.
+    static void setPersistenceFile(const std::string& path, int saveEvery = 16);
+    /// @brief Write the cache to the persistence file now.
+    /// @return False if there is no persistence file or it couldn't be written.
+    static bool save();
+private:
+    typedef std::list<std::pair<uint64_t, std::string>> EntryList;
+    /// @brief A copy of the entries to write to 'path', taken under 'mtx' and written outside of it.
+    struct Snapshot {
+        std::string path;
+        uint64_t seq = 0;
+        std::vector<std::pair<uint64_t, std::string>> entries;     //Least recently used first
+    };
+    static void putUnlocked(uint64_t key, const std::string& res);
+    static void evict();
+    static Snapshot takeSnapshot();
+    static bool writeSnapshot(const Snapshot& snap);
+    static bool loadUnlocked();
+
+    static std::mutex mtx;
+    static EntryList entries;   //Most recently used first
+    static std::unordered_map<uint64_t, EntryList::iterator> index;
+    static size_t capacity;
+    static uint64_t numHits, numMisses;
+    static std::string persistPath;
+    static int persistEvery;
+    static int numUnsaved;
+    static std::mutex saveMtx;              //Serializes writing the persistence file
+    static uint64_t snapshotSeq, savedSeq;  //Numbers of the last snapshot taken (guarded by 'mtx') and written (guarded by 'saveMtx')
+}; }
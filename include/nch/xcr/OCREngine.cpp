@@ -0,0 +1,435 @@
+#include "OCREngine.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <nch/cpp-utils/log.h>
+#include <nch/cpp-utils/string-utils.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include "OCRCache.h"
+#ifdef XCR_HAVE_TESSERACT
+#include <tesseract/baseapi.h>
+#endif
+
+using namespace nch;
+
+std::mutex OCREngine::mtx;
+std::condition_variable OCREngine::engineFreed;
+std::multimap<std::string, tesseract::TessBaseAPI*> OCREngine::idleEngines;
+int OCREngine::numEngines = 0;
+int OCREngine::maxEngines = 0;
+
+namespace {
+    //Unlike StringUtils::split(), keeps empty fields (ex: the empty text of TSV rows that aren't words)
+    std::vector<std::string> splitFields(const std::string& s, char delim) {
+        std::vector<std::string> res;
+        size_t start = 0;
+        for(size_t d = s.find(delim); d!=std::string::npos; d = s.find(delim, start)) {
+            res.push_back(s.substr(start, d-start));
+            start = d+1;
+        }
+        res.push_back(s.substr(start));
+        return res;
+    }
+}
+
+OCROptions OCROptions::fromArgs(const std::string& args)
+{
+    OCROptions res;
+    std::vector<std::string> tokens;
+    std::stringstream ss(args);
+    for(std::string t; ss >> t; ) tokens.push_back(t);
+
+    std::stringstream extra;
+    for(size_t i = 0; i<tokens.size(); i++) {
+        const std::string& t = tokens[i];
+        bool hasNext = i+1<tokens.size();
+        if(t=="--psm" && hasNext)       { res.psm = atoi(tokens[++i].c_str()); continue; }
+        if(t=="--dpi" && hasNext)       { res.dpi = atoi(tokens[++i].c_str()); continue; }
+        if(t=="-l" && hasNext)          { res.lang = tokens[++i]; continue; }
+        if(t=="-c" && hasNext && tokens[i+1].find("tessedit_char_whitelist=")==0) {
+            res.whitelist = tokens[++i].substr(24);
+            continue;
+        }
+        extra << (extra.tellp()>0 ? " " : "") << t;
+    }
+    res.extraArgs = extra.str();
+    return res;
+}
+
+std::string OCROptions::toArgs() const
+{
+    std::stringstream res;
+    res << "-l " << lang;
+    if(psm>=0)  res << " --psm " << psm;
+    if(dpi>0)   res << " --dpi " << dpi;
+    if(whitelist!="") {
+        //Single-quoted for the shell
+        std::string quoted;
+        for(size_t i = 0; i<whitelist.size(); i++) {
+            if(whitelist[i]=='\'') quoted += "'\\''";
+            else quoted += whitelist[i];
+        }
+        res << " -c 'tessedit_char_whitelist=" << quoted << "'";
+    }
+    if(extraArgs!="") res << " " << extraArgs;
+    return res.str();
+}
+
+std::vector<std::string> OCROptions::toArgv() const
+{
+    std::vector<std::string> res;
+    res.push_back("-l"); res.push_back(lang);
+    if(psm>=0)  { res.push_back("--psm"); res.push_back(std::to_string(psm)); }
+    if(dpi>0)   { res.push_back("--dpi"); res.push_back(std::to_string(dpi)); }
+    if(whitelist!="") { res.push_back("-c"); res.push_back("tessedit_char_whitelist="+whitelist); }
+    std::stringstream ss(extraArgs);
+    for(std::string t; ss >> t; ) res.push_back(t);
+    return res;
+}
+
+std::string OCREngine::recognize(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts) {
+    return run(pixels, w, h, pitch, opts, OUTPUT_TEXT);
+}
+std::string OCREngine::recognize(SDL_Surface* surf, const OCROptions& opts)
+{
+    if(surf==nullptr) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning \"\"", "'surf' is NULL");
+        return "";
+    }
+
+    //Work on BGRA32 no matter what the surface's format is
+    SDL_Surface* conv = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_BGRA32, 0);
+    if(conv==NULL) {
+        Log::errorv(__PRETTY_FUNCTION__, "SDL_ConvertSurfaceFormat()", SDL_GetError());
+        return "";
+    }
+    std::string res = run((const uint8_t*)conv->pixels, conv->w, conv->h, conv->pitch, opts, OUTPUT_TEXT);
+    SDL_FreeSurface(conv);
+    return res;
+}
+std::string OCREngine::recognizeBoxes(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts) {
+    return run(pixels, w, h, pitch, opts, OUTPUT_BOXES);
+}
+std::string OCREngine::recognizeTSV(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts) {
+    return run(pixels, w, h, pitch, opts, OUTPUT_TSV);
+}
+
+bool OCREngine::isEmbedded()
+{
+#ifdef XCR_HAVE_TESSERACT
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OCREngine::prewarm(int num, const std::string& lang)
+{
+#ifdef XCR_HAVE_TESSERACT
+    //Every engine is held until the end, so asking for more than 'maxEngines' would wait on ourselves forever
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(maxEngines==0) maxEngines = std::max(1u, std::thread::hardware_concurrency());
+        num = std::min(num, maxEngines);
+    }
+    std::vector<tesseract::TessBaseAPI*> apis;
+    for(int i = 0; i<num; i++) {
+        tesseract::TessBaseAPI* api = acquire(lang);
+        if(api==nullptr) break;
+        apis.push_back(api);
+    }
+    for(size_t i = 0; i<apis.size(); i++) release(apis[i], lang);
+#else
+    Log::warnv(__PRETTY_FUNCTION__, "doing nothing", "Built without libtesseract (XCR_HAVE_TESSERACT)");
+#endif
+}
+
+void OCREngine::setMaxEngines(int max)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    maxEngines = std::max(1, max);
+}
+
+void OCREngine::free()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+#ifdef XCR_HAVE_TESSERACT
+    for(auto& e : idleEngines) {
+        e.second->End();
+        delete e.second;
+        numEngines--;
+    }
+#endif
+    idleEngines.clear();
+}
+
+std::vector<uint8_t> OCREngine::toGray(const uint8_t* pixels, int w, int h, int pitch)
+{
+    std::vector<uint8_t> res((size_t)w*h);
+    OCRPreprocess::toGray(pixels, w, h, pitch, res.data());
+    return res;
+}
+
+std::string OCREngine::run(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts, Output out)
+{
+    if(pixels==nullptr || w<=0 || h<=0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning \"\"", "Image is empty");
+        return "";
+    }
+
+    //Unchanged pixels + same settings = same text: skip Tesseract entirely on a cache hit
+    const char* outArgs[] = { "", " makebox", " tsv" };
+    uint64_t key = OCRCache::makeKey(pixels, w, h, pitch, opts.toArgs()+opts.preprocess.toKey()+outArgs[out]);
+    std::string res;
+    if(OCRCache::get(key, res)) return res;
+
+    //The backends only ever see the (minimal, single-channel) preprocessed image
+    OCRImage img = OCRPreprocess::run(pixels, w, h, pitch, opts.preprocess);
+    if(img.w==0) {
+        OCRCache::put(key, res);    //Blank image (see 'autoCrop')
+        return res;
+    }
+    OCROptions runOpts = opts;
+    if(runOpts.dpi>0) runOpts.dpi *= img.scale;
+
+    bool ok = (opts.extraArgs=="" && runEmbedded(img.pixels, img.w, img.h, runOpts, out, res)) || runCLI(img.pixels, img.w, img.h, runOpts, out, res);
+    if(ok && out!=OUTPUT_TEXT && (img.scale!=1 || img.crop.r.w!=w || img.crop.r.h!=h)) {
+        res = mapToSource(res, out, img, h);
+    }
+    if(ok) OCRCache::put(key, res);
+    return res;
+}
+
+bool OCREngine::runEmbedded(const std::vector<uint8_t>& gray, int w, int h, const OCROptions& opts, Output out, std::string& res)
+{
+#ifdef XCR_HAVE_TESSERACT
+    tesseract::TessBaseAPI* api = acquire(opts.lang);
+    if(api==nullptr) return false;
+
+    //Every setting is (re)applied on each call, since engines are shared between callers
+    api->SetPageSegMode(opts.psm>=0 ? (tesseract::PageSegMode)opts.psm : tesseract::PSM_AUTO);
+    api->SetVariable("tessedit_char_whitelist", opts.whitelist.c_str());
+    api->SetImage(gray.data(), w, h, 1, w);
+    if(opts.dpi>0) api->SetSourceResolution(opts.dpi);
+
+    char* text = nullptr;
+    switch(out) {
+        case OUTPUT_BOXES:  text = api->GetBoxText(0); break;
+        case OUTPUT_TSV:    text = api->GetTSVText(0); break;
+        default:            text = api->GetUTF8Text(); break;
+    }
+    res = (text!=nullptr) ? text : "";
+    delete[] text;
+    api->Clear();
+
+    release(api, opts.lang);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool OCREngine::runCLI(const std::vector<uint8_t>& gray, int w, int h, const OCROptions& opts, Output out, std::string& res)
+{
+    res = "";
+
+    /* Binary PGM in memory: no compression, and Tesseract (Leptonica) reads it directly from stdin */
+    char header[64];
+    int headerLen = snprintf(header, sizeof(header), "P5\n%d %d\n255\n", w, h);
+    std::string img(header, headerLen);
+    img.append((const char*)gray.data(), gray.size());
+
+    /* Spawn "tesseract stdin stdout <args>" directly (no /bin/sh) with pipes for stdin/stdout */
+    std::vector<std::string> args;
+    args.push_back("tesseract"); args.push_back("stdin"); args.push_back("stdout");
+    std::vector<std::string> optArgs = opts.toArgv();
+    args.insert(args.end(), optArgs.begin(), optArgs.end());
+    if(out==OUTPUT_BOXES) args.push_back("makebox");
+    if(out==OUTPUT_TSV) args.push_back("tsv");
+    std::vector<char*> argv;
+    for(size_t i = 0; i<args.size(); i++) argv.push_back(&args[i][0]);
+    argv.push_back(nullptr);
+
+    //O_CLOEXEC so that processes spawned concurrently by other threads don't inherit (and hold open) these pipes
+    int inPipe[2], outPipe[2];
+    if(pipe2(inPipe, O_CLOEXEC)!=0) {
+        Log::errorv(__PRETTY_FUNCTION__, "pipe2()", strerror(errno));
+        return false;
+    }
+    if(pipe2(outPipe, O_CLOEXEC)!=0) {
+        Log::errorv(__PRETTY_FUNCTION__, "pipe2()", strerror(errno));
+        close(inPipe[0]); close(inPipe[1]);
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, inPipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    int err = posix_spawnp(&pid, "tesseract", &actions, NULL, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(inPipe[0]);
+    close(outPipe[1]);
+    if(err!=0) {
+        Log::errorv(__PRETTY_FUNCTION__, "posix_spawnp()", "Could not run 'tesseract': %s", strerror(err));
+        close(inPipe[1]); close(outPipe[0]);
+        return false;
+    }
+
+    /* Write the image and read the result at the same time, so neither side blocks on a full pipe */
+    //If tesseract exits early, writing must fail with EPIPE instead of killing this process with SIGPIPE
+    sigset_t pipeSet, oldSet;
+    sigemptyset(&pipeSet);
+    sigaddset(&pipeSet, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+    fcntl(inPipe[1], F_SETFL, fcntl(inPipe[1], F_GETFL)|O_NONBLOCK);
+
+    size_t written = 0;
+    int inFd = inPipe[1], outFd = outPipe[0];
+    bool gotEPIPE = false;
+    char buf[4096];
+    while(outFd>=0) {
+        pollfd pfds[2];
+        int numFds = 0;
+        pfds[numFds].fd = outFd; pfds[numFds].events = POLLIN; pfds[numFds].revents = 0; numFds++;
+        if(inFd>=0) { pfds[numFds].fd = inFd; pfds[numFds].events = POLLOUT; pfds[numFds].revents = 0; numFds++; }
+        if(poll(pfds, numFds, -1)<0) {
+            if(errno==EINTR) continue;
+            break;
+        }
+
+        if(inFd>=0 && pfds[1].revents!=0) {
+            ssize_t n = write(inFd, img.data()+written, img.size()-written);
+            if(n>0) written += n;
+            if(n<0 && errno==EPIPE) gotEPIPE = true;
+            if((n<0 && errno!=EAGAIN && errno!=EINTR) || written==img.size()) {
+                close(inFd);
+                inFd = -1;
+            }
+        }
+        if(pfds[0].revents!=0) {
+            ssize_t n = read(outFd, buf, sizeof(buf));
+            if(n>0) res.append(buf, n);
+            else if(n==0 || (errno!=EAGAIN && errno!=EINTR)) {
+                close(outFd);
+                outFd = -1;
+            }
+        }
+    }
+    if(inFd>=0) close(inFd);
+    if(outFd>=0) close(outFd);
+
+    //Discard the SIGPIPE we may have caused, then restore the signal mask
+    if(gotEPIPE) {
+        timespec zero = { 0, 0 };
+        sigtimedwait(&pipeSet, NULL, &zero);
+    }
+    pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+
+    int status = 0;
+    while(waitpid(pid, &status, 0)<0 && errno==EINTR) {}
+    if(!WIFEXITED(status) || WEXITSTATUS(status)!=0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "'tesseract' failed (status %d)", status);
+        return false;
+    }
+    return true;
+}
+
+std::string OCREngine::mapToSource(const std::string& res, Output out, const OCRImage& img, int srcH)
+{
+    std::stringstream ss(res);
+    std::string mapped;
+    for(std::string line; std::getline(ss, line); ) {
+        if(out==OUTPUT_TSV) {
+            //"level page block par line word left top width height conf text"
+            std::vector<std::string> cols = splitFields(line, '\t');
+            if(cols.size()>=12 && cols[0]!="level") {
+                int x = atoi(cols[6].c_str()), y = atoi(cols[7].c_str());
+                int x2 = x+atoi(cols[8].c_str()), y2 = y+atoi(cols[9].c_str());
+                x = img.crop.r.x+x/img.scale; y = img.crop.r.y+y/img.scale;
+                x2 = img.crop.r.x+(x2+img.scale-1)/img.scale; y2 = img.crop.r.y+(y2+img.scale-1)/img.scale;
+                cols[6] = std::to_string(x); cols[7] = std::to_string(y);
+                cols[8] = std::to_string(x2-x); cols[9] = std::to_string(y2-y);
+                line = cols[0];
+                for(size_t i = 1; i<cols.size(); i++) line += "\t"+cols[i];
+            }
+        } else {
+            //"<char> x1 y1 x2 y2 page", y measured from the bottom of the image
+            std::vector<std::string> cols = splitFields(line, ' ');
+            if(cols.size()==6) {
+                int x1 = atoi(cols[1].c_str()), y1 = atoi(cols[2].c_str()), x2 = atoi(cols[3].c_str()), y2 = atoi(cols[4].c_str());
+                x1 = img.crop.r.x+x1/img.scale;
+                x2 = img.crop.r.x+(x2+img.scale-1)/img.scale;
+                //Bottom-up within the processed image -> top-down within the source -> bottom-up within the source
+                y1 = srcH-(img.crop.r.y+(img.h-y1+img.scale-1)/img.scale);
+                y2 = srcH-(img.crop.r.y+(img.h-y2)/img.scale);
+                line = cols[0]+" "+std::to_string(x1)+" "+std::to_string(y1)+" "+std::to_string(x2)+" "+std::to_string(y2)+" "+cols[5];
+            }
+        }
+        mapped += line+"\n";
+    }
+    return mapped;
+}
+
+tesseract::TessBaseAPI* OCREngine::acquire(const std::string& lang)
+{
+#ifdef XCR_HAVE_TESSERACT
+    std::unique_lock<std::mutex> lock(mtx);
+    if(maxEngines==0) maxEngines = std::max(1u, std::thread::hardware_concurrency());
+
+    while(true) {
+        //Reuse an idle engine with the right language model
+        auto itr = idleEngines.find(lang);
+        if(itr!=idleEngines.end()) {
+            tesseract::TessBaseAPI* api = itr->second;
+            idleEngines.erase(itr);
+            return api;
+        }
+        //Make room by destroying an idle engine of another language
+        if(numEngines>=maxEngines && !idleEngines.empty()) {
+            auto other = idleEngines.begin();
+            other->second->End();
+            delete other->second;
+            idleEngines.erase(other);
+            numEngines--;
+        }
+        if(numEngines<maxEngines) break;
+        engineFreed.wait(lock);
+    }
+
+    //Create a new engine (loading the language model is slow, so do it unlocked)
+    numEngines++;
+    lock.unlock();
+    tesseract::TessBaseAPI* api = new tesseract::TessBaseAPI();
+    if(api->Init(NULL, lang.c_str())!=0) {
+        Log::errorv(__PRETTY_FUNCTION__, "TessBaseAPI::Init()", "Failed to load language \"%s\"", lang.c_str());
+        delete api;
+        lock.lock();
+        numEngines--;
+        engineFreed.notify_one();
+        return nullptr;
+    }
+    return api;
+#else
+    return nullptr;
+#endif
+}
+
+void OCREngine::release(tesseract::TessBaseAPI* api, const std::string& lang)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        idleEngines.insert(std::make_pair(lang, api));
+    }
+    engineFreed.notify_one();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "OCRPreprocess.h"
+
+namespace tesseract { class TessBaseAPI; }
+
+namespace nch {
+/// @brief Per-call Tesseract settings.
+struct OCROptions {
+    int psm = -1;               //Page segmentation mode (--psm), -1 = Tesseract's default (3, fully automatic)
+    std::string whitelist;      //Only recognize these characters (tessedit_char_whitelist), "" = all
+    int dpi = 0;                //Source resolution (--dpi), 0 = unspecified (Tesseract assumes 70)
+    std::string lang = "eng";   //Language model(s) (-l), ex: "eng+deu"
+    std::string extraArgs;      //Any other 'tesseract' CLI arguments. If not "", the CLI is always used for this call.
+    OCRPreprocessOptions preprocess;    //Cleanup (scaling, thresholding, inversion, cropping) applied before recognition. Boxes are still reported in source image coordinates.
+
+    /// @brief Parse 'tesseract' CLI arguments (ex: "--psm 6 -c tessedit_char_whitelist=0123456789"). Arguments that have no field go to 'extraArgs'.
+    static OCROptions fromArgs(const std::string& args);
+    /// @return These options as 'tesseract' CLI arguments, quoted for a shell.
+    std::string toArgs() const;
+    /// @return These options as separate 'tesseract' arguments (no quoting needed), ex: for posix_spawn().
+    std::vector<std::string> toArgv() const;
+};
+
+class OCREngine {
+public:
+    /// @brief Perform OCR on a raw pixel buffer (ex: straight from Xcalibur's captured frame), without any file or process.
+    /// @brief With libtesseract (XCR_HAVE_TESSERACT), a pool of pre-initialized TessBaseAPI engines is used, so language models are only loaded once.
+    /// @brief Without it (or if 'opts.extraArgs' is set), falls back to the 'tesseract' CLI: the image is streamed to it as a PGM over a pipe (no disk I/O, no shell).
+    /// @brief Results are cached by image contents + settings (see OCRCache), so re-reading an unchanged region costs a hash instead of a Tesseract run.
+    /// @param pixels Top-left pixel of the image, in BGRA32 (SDL_PIXELFORMAT_BGRA32, the format of Xcalibur's 'screenSurf').
+    /// @param pitch Number of bytes between the start of two rows.
+    /// @return The OCR-detected text (may include newlines), or "" on failure.
+    static std::string recognize(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts);
+    static std::string recognize(SDL_Surface* surf, const OCROptions& opts);
+    /// @brief Same as 'recognize()' but returns Tesseract's box file ("makebox"): one line per character, "<char> <x1> <y1> <x2> <y2> <page>" with y measured from the bottom.
+    static std::string recognizeBoxes(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts);
+    /// @brief Same as 'recognize()' but returns Tesseract's TSV output: one row per page/block/paragraph/line/word with its box (top-left origin) and confidence.
+    /// @brief See OCRIndex::fromTSV() to search it.
+    static std::string recognizeTSV(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts);
+
+    /// @return True if the embedded (libtesseract) backend was compiled in.
+    static bool isEmbedded();
+    /// @brief Create 'numEngines' engines for 'lang' up front, so that the first calls don't pay for loading the language model.
+    /// @brief 'numEngines' is capped at the maximum number of engines (see setMaxEngines()).
+    static void prewarm(int numEngines, const std::string& lang = "eng");
+    /// @brief Set the maximum number of engines alive at once (default: number of CPU cores). Callers beyond that wait for a free engine.
+    static void setMaxEngines(int maxEngines);
+    /// @brief Destroy every idle engine.
+    static void free();
+
+    /// @brief Convert BGRA32 pixels to 8-bit grayscale (ITU-R BT.601 luma). See OCRPreprocess for the full preprocessing pipeline.
+    static std::vector<uint8_t> toGray(const uint8_t* pixels, int w, int h, int pitch);
+private:
+    enum Output { OUTPUT_TEXT, OUTPUT_BOXES, OUTPUT_TSV };
+    static std::string run(const uint8_t* pixels, int w, int h, int pitch, const OCROptions& opts, Output out);
+    static bool runEmbedded(const std::vector<uint8_t>& gray, int w, int h, const OCROptions& opts, Output out, std::string& res);
+    static bool runCLI(const std::vector<uint8_t>& gray, int w, int h, const OCROptions& opts, Output out, std::string& res);
+    static std::string mapToSource(const std::string& res, Output out, const OCRImage& img, int srcH);
+    static tesseract::TessBaseAPI* acquire(const std::string& lang);
+    static void release(tesseract::TessBaseAPI* api, const std::string& lang);
+
+    static std::mutex mtx;
+    static std::condition_variable engineFreed;
+    static std::multimap<std::string, tesseract::TessBaseAPI*> idleEngines;
+    static int numEngines;
+    static int maxEngines;
+}; }
@@ -0,0 +1,217 @@
+#include "OCRIndex.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <sstream>
+
+using namespace nch;
+
+OCRIndex::OCRIndex(){}
+
+OCRIndex OCRIndex::fromTSV(const std::string& tsv, const Vec2i& origin)
+{
+    OCRIndex res;
+
+    //Columns: level page_num block_num par_num line_num word_num left top width height conf text
+    std::stringstream ss(tsv);
+    int lastBlock = -1, lastPar = -1, lastLine = -1;
+    for(std::string row; std::getline(ss, row); ) {
+        if(row.size()>0 && row[row.size()-1]=='\r') row.erase(row.size()-1);
+        std::vector<std::string> cols;
+        size_t start = 0;
+        for(size_t tab = row.find('\t'); tab!=std::string::npos; tab = row.find('\t', start)) {
+            cols.push_back(row.substr(start, tab-start));
+            start = tab+1;
+        }
+        cols.push_back(row.substr(start));
+        if(cols.size()<12 || atoi(cols[0].c_str())!=5) continue;   //Header row, or not a word
+
+        OCRWord word;
+        word.text = cols[11];
+        word.text.erase(0, word.text.find_first_not_of(' '));
+        word.text.erase(word.text.find_last_not_of(' ')+1);
+        if(word.text=="") continue;
+        word.box = Rect(origin.x+atoi(cols[6].c_str()), origin.y+atoi(cols[7].c_str()), atoi(cols[8].c_str()), atoi(cols[9].c_str()));
+        word.conf = atof(cols[10].c_str());
+
+        //Start a new line whenever Tesseract's block/paragraph/line number changes
+        int block = atoi(cols[2].c_str()), par = atoi(cols[3].c_str()), line = atoi(cols[4].c_str());
+        res.addWord(word, block!=lastBlock || par!=lastPar || line!=lastLine);
+        lastBlock = block; lastPar = par; lastLine = line;
+    }
+    return res;
+}
+
+void OCRIndex::addWord(const OCRWord& word, bool newLine)
+{
+    if(lines.empty() || newLine) {
+        OCRLine l;
+        l.box = word.box;
+        l.firstWord = words.size();
+        lines.push_back(l);
+    }
+    OCRLine& l = lines.back();
+    l.box = Rect::createFromTwoPts(
+        std::min(l.box.x1(), word.box.x1()), std::min(l.box.y1(), word.box.y1()),
+        std::max(l.box.x2(), word.box.x2()), std::max(l.box.y2(), word.box.y2())
+    );
+    l.numWords++;
+    words.push_back(word);
+    words.back().line = lines.size()-1;
+}
+
+const std::vector<OCRWord>& OCRIndex::getWords() const { return words; }
+const std::vector<OCRLine>& OCRIndex::getLines() const { return lines; }
+
+std::string OCRIndex::getLineText(int line) const
+{
+    if(line<0 || line>=(int)lines.size()) return "";
+    std::string res;
+    for(int i = 0; i<lines[line].numWords; i++) {
+        if(i>0) res += " ";
+        res += words[lines[line].firstWord+i].text;
+    }
+    return res;
+}
+std::string OCRIndex::getText() const
+{
+    std::string res;
+    for(size_t i = 0; i<lines.size(); i++) {
+        if(i>0) res += "\n";
+        res += getLineText(i);
+    }
+    return res;
+}
+
+std::vector<OCRMatch> OCRIndex::find(const std::string& needle, const OCRSearchOptions& opts) const {
+    return findAll(std::vector<std::string>(1, needle), opts)[0];
+}
+
+std::vector<std::vector<OCRMatch>> OCRIndex::findAll(const std::vector<std::string>& needles, const OCRSearchOptions& opts) const
+{
+    std::vector<std::vector<OCRMatch>> res(needles.size());
+    std::vector<SearchLine> searchLines = buildSearchLines(opts);
+    for(size_t n = 0; n<needles.size(); n++) {
+        std::string needle = normalize(needles[n], opts.ignoreCase);
+        if(needle=="") continue;
+        for(size_t l = 0; l<searchLines.size(); l++) {
+            findInLine(searchLines[l], l, needle, opts.maxEdits, res[n]);
+        }
+    }
+    return res;
+}
+
+int OCRIndex::editDistance(const std::string& a, const std::string& b)
+{
+    std::vector<int> prev(b.size()+1), cur(b.size()+1);
+    for(size_t j = 0; j<=b.size(); j++) prev[j] = j;
+    for(size_t i = 1; i<=a.size(); i++) {
+        cur[0] = i;
+        for(size_t j = 1; j<=b.size(); j++) {
+            cur[j] = std::min(prev[j-1]+(a[i-1]!=b[j-1]), std::min(prev[j], cur[j-1])+1);
+        }
+        prev.swap(cur);
+    }
+    return prev[b.size()];
+}
+
+std::vector<OCRIndex::SearchLine> OCRIndex::buildSearchLines(const OCRSearchOptions& opts) const
+{
+    std::vector<SearchLine> res(lines.size());
+    for(size_t l = 0; l<lines.size(); l++) {
+        for(int i = lines[l].firstWord; i<lines[l].firstWord+lines[l].numWords; i++) {
+            if(words[i].conf<opts.minConf) continue;
+            std::string t = normalize(words[i].text, opts.ignoreCase);
+            res[l].text += t;
+            res[l].charWord.insert(res[l].charWord.end(), t.size(), i);
+        }
+    }
+    return res;
+}
+
+void OCRIndex::findInLine(const SearchLine& sl, int line, const std::string& needle, int maxEdits, std::vector<OCRMatch>& res) const
+{
+    const std::string& text = sl.text;
+    if(text=="") return;
+
+    /* Candidate occurrences as [start, end) character ranges within 'text' */
+    struct Candidate { int start, end, edits; };
+    std::vector<Candidate> cands;
+    if(maxEdits<=0) {
+        for(size_t i = text.find(needle); i!=std::string::npos; i = text.find(needle, i+needle.size())) {
+            Candidate c = { (int)i, (int)(i+needle.size()), 0 };
+            cands.push_back(c);
+        }
+    } else {
+        //Approximate substring matching (Sellers): like Levenshtein, but a match may start anywhere in 'text' for free.
+        //'from[j]' tracks where the best alignment ending at text[j-1] started.
+        int n = text.size(), m = needle.size();
+        std::vector<int> prev(n+1, 0), cur(n+1), prevFrom(n+1), curFrom(n+1);
+        for(int j = 0; j<=n; j++) prevFrom[j] = j;
+        for(int i = 1; i<=m; i++) {
+            cur[0] = i; curFrom[0] = 0;
+            for(int j = 1; j<=n; j++) {
+                int sub = prev[j-1]+(needle[i-1]!=text[j-1]);
+                int del = prev[j]+1;        //Needle character missing from the text
+                int ins = cur[j-1]+1;       //Extra character in the text
+                if(sub<=del && sub<=ins)    { cur[j] = sub; curFrom[j] = prevFrom[j-1]; }
+                else if(del<=ins)           { cur[j] = del; curFrom[j] = prevFrom[j]; }
+                else                        { cur[j] = ins; curFrom[j] = curFrom[j-1]; }
+            }
+            prev.swap(cur);
+            prevFrom.swap(curFrom);
+        }
+        for(int j = 1; j<=n; j++) {
+            if(prev[j]<=maxEdits && prevFrom[j]<j) {
+                Candidate c = { prevFrom[j], j, prev[j] };
+                cands.push_back(c);
+            }
+        }
+
+        //Overlapping candidates describe the same occurrence: keep the closest ones (then the ones closest in length to the needle)
+        std::stable_sort(cands.begin(), cands.end(), [m](const Candidate& a, const Candidate& b) {
+            if(a.edits!=b.edits) return a.edits<b.edits;
+            return std::abs(a.end-a.start-m)<std::abs(b.end-b.start-m);
+        });
+        std::vector<Candidate> kept;
+        for(size_t i = 0; i<cands.size(); i++) {
+            bool overlaps = false;
+            for(size_t k = 0; k<kept.size() && !overlaps; k++)
+                overlaps = cands[i].start<kept[k].end && kept[k].start<cands[i].end;
+            if(!overlaps) kept.push_back(cands[i]);
+        }
+        std::sort(kept.begin(), kept.end(), [](const Candidate& a, const Candidate& b) { return a.start<b.start; });
+        cands.swap(kept);
+    }
+
+    /* Turn character ranges back into word boxes */
+    for(size_t i = 0; i<cands.size(); i++) {
+        OCRMatch match;
+        match.line = line;
+        match.firstWord = sl.charWord[cands[i].start];
+        match.lastWord = sl.charWord[cands[i].end-1];
+        match.edits = cands[i].edits;
+        match.text = text.substr(cands[i].start, cands[i].end-cands[i].start);
+        match.box = words[match.firstWord].box;
+        for(int w = match.firstWord+1; w<=match.lastWord; w++) {
+            const Rect& b = words[w].box;
+            match.box = Rect::createFromTwoPts(
+                std::min(match.box.x1(), b.x1()), std::min(match.box.y1(), b.y1()),
+                std::max(match.box.x2(), b.x2()), std::max(match.box.y2(), b.y2())
+            );
+        }
+        res.push_back(match);
+    }
+}
+
+std::string OCRIndex::normalize(const std::string& s, bool ignoreCase)
+{
+    std::string res;
+    res.reserve(s.size());
+    for(size_t i = 0; i<s.size(); i++) {
+        char c = s[i];
+        if(c==' ' || c=='\t' || c=='\n') continue;
+        if(ignoreCase && c>='A' && c<='Z') c += 'a'-'A';
+        res += c;
+    }
+    return res;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <nch/math-utils/vec2.h>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include <vector>
+
+namespace nch {
+/// @brief A single word detected by Tesseract.
+struct OCRWord {
+    std::string text;
+    nch::Rect box;      //Bounding box, top-left origin (offset by the index's origin)
+    float conf = 0;     //Tesseract's confidence, 0-100
+    int line = 0;       //Index of the OCRLine this word belongs to
+};
+/// @brief A line of words, as segmented by Tesseract (block/paragraph/line).
+struct OCRLine {
+    nch::Rect box;
+    int firstWord = 0;  //Index of the line's first OCRWord
+    int numWords = 0;
+};
+/// @brief Settings for OCRIndex::find().
+struct OCRSearchOptions {
+    bool ignoreCase = false;    //Compare ASCII letters case-insensitively
+    int maxEdits = 0;           //Fuzzy matching: max number of inserted, deleted or substituted characters (Levenshtein distance). 0 = exact.
+    float minConf = 0;          //Ignore words whose confidence is below this
+};
+/// @brief One occurrence of a needle within an OCRIndex.
+struct OCRMatch {
+    nch::Rect box;          //Union of the boxes of the matched words
+    int line = 0;           //Index of the OCRLine the match is in
+    int firstWord = 0;      //Indices of the first and last matched OCRWord
+    int lastWord = 0;
+    int edits = 0;          //Edit distance between the needle and the matched text (0 = exact)
+    std::string text;       //The matched text (spaces removed)
+};
+
+class OCRIndex {
+public:
+    OCRIndex();
+    /// @brief Build an index from Tesseract's TSV output (the 'tsv' config, or TessBaseAPI::GetTSVText()).
+    /// @param origin Added to every box, ex: the position of the OCR'd area on the display.
+    static OCRIndex fromTSV(const std::string& tsv, const nch::Vec2i& origin = nch::Vec2i(0, 0));
+
+    /// @brief Append a word (ex: when combining or remapping indices). Its 'line' is set by the index.
+    /// @param newLine Start a new line with this word, instead of continuing the last one.
+    void addWord(const OCRWord& word, bool newLine);
+
+    const std::vector<OCRWord>& getWords() const;
+    const std::vector<OCRLine>& getLines() const;
+    /// @return The text of line 'line', words separated by single spaces.
+    std::string getLineText(int line) const;
+    /// @return All lines of text, separated by '\n'.
+    std::string getText() const;
+
+    /// @brief Find every occurrence of 'needle' without any further OCR. Spaces are ignored on both sides, so a needle may span several words of a line.
+    /// @return The non-overlapping matches (best ones first when fuzzy matches overlap), top to bottom and left to right.
+    std::vector<OCRMatch> find(const std::string& needle, const OCRSearchOptions& opts = OCRSearchOptions()) const;
+    /// @brief Same as 'find()' for many needles at once: each line is normalized only once for all of them.
+    /// @return One list of matches per needle, in the same order as 'needles'.
+    std::vector<std::vector<OCRMatch>> findAll(const std::vector<std::string>& needles, const OCRSearchOptions& opts = OCRSearchOptions()) const;
+
+    /// @return The Levenshtein distance between 'a' and 'b' (bytes).
+    static int editDistance(const std::string& a, const std::string& b);
+private:
+    /// @brief A line with spaces removed (and lowercased if needed), where each character remembers the word it came from.
+    struct SearchLine { std::string text; std::vector<int> charWord; };
+    std::vector<SearchLine> buildSearchLines(const OCRSearchOptions& opts) const;
+    void findInLine(const SearchLine& sl, int line, const std::string& needle, int maxEdits, std::vector<OCRMatch>& res) const;
+    static std::string normalize(const std::string& s, bool ignoreCase);
+
+    std::vector<OCRWord> words;
+    std::vector<OCRLine> lines;
+};
+}
@@ -0,0 +1,284 @@
+#include "OCRPreprocess.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace nch;
+
+namespace {
+    thread_local OCRPreprocessTimings lastTimings;
+    typedef std::chrono::steady_clock Clock;
+    inline double elapsedUS(const Clock::time_point& from, const Clock::time_point& to) {
+        return std::chrono::duration<double, std::micro>(to-from).count();
+    }
+    inline double elapsedUS(Clock::time_point& t) {
+        Clock::time_point now = Clock::now();
+        double res = elapsedUS(t, now);
+        t = now;
+        return res;
+    }
+}
+
+std::string OCRPreprocessOptions::toKey() const
+{
+    OCRPreprocessOptions def;
+    std::stringstream res;
+    if(scale>1)                     res << " scale=" << scale;
+    if(threshold==THRESHOLD_OTSU)   res << " otsu";
+    if(threshold==THRESHOLD_ADAPTIVE) res << " adaptive=" << adaptiveRadius << "," << adaptiveOffset;
+    if(invert!=def.invert)          res << " invert=" << invert;
+    if(autoCrop)                    res << " crop=" << cropTolerance << "," << cropMargin;
+    return res.str();
+}
+
+OCRImage OCRPreprocess::run(const uint8_t* pixels, int w, int h, int pitch, const OCRPreprocessOptions& opts)
+{
+    OCRImage res;
+    if(pixels==nullptr || w<=0 || h<=0) {
+        lastTimings = res.timings;
+        return res;
+    }
+    Clock::time_point tStart = Clock::now(), t = tStart;
+
+    /* Gray */
+    std::vector<uint8_t> gray((size_t)w*h);
+    toGray(pixels, w, h, pitch, gray.data());
+    uint64_t hist[256] = { 0 };
+    if(opts.invert==-1 || opts.autoCrop) histogram(gray, hist);
+    res.timings.grayUS = elapsedUS(t);
+
+    /* Invert (OCR expects dark text on a light background) */
+    bool inv = opts.invert==1;
+    if(opts.invert==-1) {
+        uint64_t sum = 0;
+        for(int i = 0; i<256; i++) sum += hist[i]*i;
+        inv = sum<(uint64_t)128*gray.size();
+    }
+    if(inv) {
+        invert(gray);
+        std::reverse(hist, hist+256);
+    }
+    res.timings.invertUS = elapsedUS(t);
+
+    /* Crop to the content */
+    Rect crop(0, 0, w, h);
+    if(opts.autoCrop) {
+        if(!findContent(gray, w, h, hist, opts, crop)) {
+            //Nothing but background: nothing to recognize
+            res.timings.cropUS = elapsedUS(t);
+            res.timings.totalUS = elapsedUS(tStart, t);
+            lastTimings = res.timings;
+            return res;
+        }
+        if(crop.r.w!=w || crop.r.h!=h) {
+            std::vector<uint8_t> cropped((size_t)crop.r.w*crop.r.h);
+            for(int y = 0; y<crop.r.h; y++) {
+                memcpy(cropped.data()+(size_t)y*crop.r.w, gray.data()+(size_t)(crop.r.y+y)*w+crop.r.x, crop.r.w);
+            }
+            gray.swap(cropped);
+        }
+    }
+    res.timings.cropUS = elapsedUS(t);
+
+    /* Scale */
+    int scale = std::max(1, opts.scale);
+    if(scale>1) gray = upscale(gray, crop.r.w, crop.r.h, scale);
+    res.timings.scaleUS = elapsedUS(t);
+
+    /* Threshold */
+    int sw = crop.r.w*scale, sh = crop.r.h*scale;
+    if(opts.threshold==OCRPreprocessOptions::THRESHOLD_OTSU) {
+        uint64_t scaledHist[256];
+        histogram(gray, scaledHist);
+        int level = otsuLevel(scaledHist);
+        uint8_t lut[256];
+        for(int i = 0; i<256; i++) lut[i] = i>level ? 255 : 0;
+        for(size_t i = 0; i<gray.size(); i++) gray[i] = lut[gray[i]];
+    } else if(opts.threshold==OCRPreprocessOptions::THRESHOLD_ADAPTIVE) {
+        thresholdAdaptive(gray, sw, sh, std::max(1, opts.adaptiveRadius), opts.adaptiveOffset);
+    }
+    res.timings.thresholdUS = elapsedUS(t);
+
+    res.pixels.swap(gray);
+    res.w = sw; res.h = sh;
+    res.crop = crop;
+    res.scale = scale;
+    res.timings.totalUS = elapsedUS(tStart, t);
+    lastTimings = res.timings;
+    return res;
+}
+
+OCRPreprocessTimings OCRPreprocess::getLastTimings() { return lastTimings; }
+
+void OCRPreprocess::toGray(const uint8_t* pixels, int w, int h, int pitch, uint8_t* dst)
+{
+    //Fixed-point weights summing to 256 (0.114, 0.587, 0.299). The largest sum (255*256) fits in 16 bits.
+    for(int y = 0; y<h; y++) {
+        const uint8_t* src = pixels+(size_t)y*pitch;
+        uint8_t* out = dst+(size_t)y*w;
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i wB = _mm_set1_epi16(29), wG = _mm_set1_epi16(150), wR = _mm_set1_epi16(77);
+        for(; x+16<=w; x += 16) {
+            __m128i p[4];
+            for(int i = 0; i<4; i++) p[i] = _mm_loadu_si128((const __m128i*)(src+4*x+16*i));
+
+            //Split 2x8 pixels into 16-bit B, G and R lanes, then weigh and sum them
+            __m128i sum[2];
+            for(int i = 0; i<2; i++) {
+                __m128i b = _mm_packs_epi32(_mm_and_si128(p[2*i], mask), _mm_and_si128(p[2*i+1], mask));
+                __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p[2*i], 8), mask), _mm_and_si128(_mm_srli_epi32(p[2*i+1], 8), mask));
+                __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p[2*i], 16), mask), _mm_and_si128(_mm_srli_epi32(p[2*i+1], 16), mask));
+                sum[i] = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(b, wB), _mm_mullo_epi16(g, wG)), _mm_mullo_epi16(r, wR));
+                sum[i] = _mm_srli_epi16(sum[i], 8);
+            }
+            _mm_storeu_si128((__m128i*)(out+x), _mm_packus_epi16(sum[0], sum[1]));
+        }
+#endif
+        for(; x<w; x++) {
+            out[x] = (src[4*x]*29+src[4*x+1]*150+src[4*x+2]*77)>>8;
+        }
+    }
+}
+
+int OCRPreprocess::otsuLevel(const uint64_t* hist)
+{
+    uint64_t total = 0; double sumAll = 0;
+    for(int i = 0; i<256; i++) { total += hist[i]; sumAll += (double)i*hist[i]; }
+    if(total==0) return 127;
+
+    uint64_t numBelow = 0; double sumBelow = 0;
+    double bestVar = -1; int res = 127;
+    for(int t = 0; t<256; t++) {
+        numBelow += hist[t];
+        sumBelow += (double)t*hist[t];
+        uint64_t numAbove = total-numBelow;
+        if(numBelow==0) continue;
+        if(numAbove==0) break;
+
+        double meanBelow = sumBelow/numBelow, meanAbove = (sumAll-sumBelow)/numAbove;
+        double var = (double)numBelow*numAbove*(meanBelow-meanAbove)*(meanBelow-meanAbove);
+        if(var>bestVar) { bestVar = var; res = t; }
+    }
+    return res;
+}
+
+void OCRPreprocess::histogram(const std::vector<uint8_t>& gray, uint64_t* hist)
+{
+    //4 partial histograms, so that runs of equal pixels (flat UI backgrounds) don't serialize on one counter
+    uint32_t part[4][256];
+    memset(part, 0, sizeof(part));
+    const uint8_t* p = gray.data();
+    size_t n = gray.size(), i = 0;
+    for(; i+4<=n; i += 4) {
+        part[0][p[i]]++; part[1][p[i+1]]++; part[2][p[i+2]]++; part[3][p[i+3]]++;
+    }
+    for(; i<n; i++) part[0][p[i]]++;
+    for(int v = 0; v<256; v++) hist[v] = (uint64_t)part[0][v]+part[1][v]+part[2][v]+part[3][v];
+}
+
+void OCRPreprocess::invert(std::vector<uint8_t>& gray)
+{
+    uint8_t* p = gray.data();
+    size_t n = gray.size(), i = 0;
+#ifdef __SSE2__
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    for(; i+16<=n; i += 16) {
+        _mm_storeu_si128((__m128i*)(p+i), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p+i)), ones));
+    }
+#endif
+    for(; i<n; i++) p[i] = 255-p[i];
+}
+
+bool OCRPreprocess::findContent(const std::vector<uint8_t>& gray, int w, int h, const uint64_t* hist, const OCRPreprocessOptions& opts, Rect& res)
+{
+    //UI backgrounds are flat: the most common gray level is the background
+    int bg = std::max_element(hist, hist+256)-hist;
+    int lo = bg-opts.cropTolerance, hi = bg+opts.cropTolerance;
+
+    int x0 = w, y0 = h, x1 = -1, y1 = -1;
+    for(int y = 0; y<h; y++) {
+        const uint8_t* row = gray.data()+(size_t)y*w;
+        int first = -1;
+        for(int x = 0; x<w; x++) {
+            if(row[x]<lo || row[x]>hi) { first = x; break; }
+        }
+        if(first<0) continue;
+        //From the right, only scan as far as the box already reaches
+        int last = first;
+        for(int x = w-1; x>std::max(first, x1); x--) {
+            if(row[x]<lo || row[x]>hi) { last = x; break; }
+        }
+        x0 = std::min(x0, first); x1 = std::max(x1, last);
+        if(y0==h) y0 = y;
+        y1 = y;
+    }
+    if(x1<0) return false;
+
+    int m = std::max(0, opts.cropMargin);
+    x0 = std::max(0, x0-m); y0 = std::max(0, y0-m);
+    x1 = std::min(w-1, x1+m); y1 = std::min(h-1, y1+m);
+    res = Rect(x0, y0, x1-x0+1, y1-y0+1);
+    return true;
+}
+
+std::vector<uint8_t> OCRPreprocess::upscale(const std::vector<uint8_t>& src, int w, int h, int scale)
+{
+    int dw = w*scale, dh = h*scale;
+    std::vector<uint8_t> res((size_t)dw*dh);
+
+    //Bilinear, sampling the source at pixel centers. Sample positions have 8 fractional bits.
+    std::vector<int> sx0(dw), sx1(dw), fx(dw);
+    for(int x = 0; x<dw; x++) {
+        int s = std::max(0, (2*x+1)*256/(2*scale)-128);
+        sx0[x] = std::min(s>>8, w-1); sx1[x] = std::min(sx0[x]+1, w-1); fx[x] = s&255;
+    }
+    for(int y = 0; y<dh; y++) {
+        int s = std::max(0, (2*y+1)*256/(2*scale)-128);
+        int y0 = std::min(s>>8, h-1), y1 = std::min(y0+1, h-1), fy = s&255;
+        const uint8_t* r0 = src.data()+(size_t)y0*w;
+        const uint8_t* r1 = src.data()+(size_t)y1*w;
+        uint8_t* out = res.data()+(size_t)y*dw;
+        for(int x = 0; x<dw; x++) {
+            int top = r0[sx0[x]]*(256-fx[x])+r0[sx1[x]]*fx[x];
+            int bot = r1[sx0[x]]*(256-fx[x])+r1[sx1[x]]*fx[x];
+            out[x] = (top*(256-fy)+bot*fy+32768)>>16;
+        }
+    }
+    return res;
+}
+
+void OCRPreprocess::thresholdAdaptive(std::vector<uint8_t>& gray, int w, int h, int radius, int offset)
+{
+    //Integral image: each pixel is compared to the mean of the (2*radius+1)^2 window around it, in O(1).
+    //Sums may wrap around on huge images, but window sums (differences) are still exact in unsigned arithmetic.
+    std::vector<uint32_t> integral((size_t)(w+1)*(h+1), 0);
+    for(int y = 0; y<h; y++) {
+        uint32_t rowSum = 0;
+        const uint8_t* row = gray.data()+(size_t)y*w;
+        uint32_t* above = integral.data()+(size_t)y*(w+1);
+        uint32_t* cur = above+(w+1);
+        for(int x = 0; x<w; x++) {
+            rowSum += row[x];
+            cur[x+1] = above[x+1]+rowSum;
+        }
+    }
+    for(int y = 0; y<h; y++) {
+        int ya = std::max(0, y-radius), yb = std::min(h, y+radius+1);
+        const uint32_t* ia = integral.data()+(size_t)ya*(w+1);
+        const uint32_t* ib = integral.data()+(size_t)yb*(w+1);
+        uint8_t* row = gray.data()+(size_t)y*w;
+        for(int x = 0; x<w; x++) {
+            int xa = std::max(0, x-radius), xb = std::min(w, x+radius+1);
+            uint32_t sum = ib[xb]-ib[xa]-ia[xb]+ia[xa];
+            int area = (xb-xa)*(yb-ya);
+            //Text (dark) if darker than the local mean by more than 'offset'
+            row[x] = ((int)row[x]*area+offset*area<(int)sum) ? 0 : 255;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <nch/sdl-utils/rect.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nch {
+/// @brief Image cleanup done before OCR. The defaults only convert to grayscale.
+struct OCRPreprocessOptions {
+    enum Threshold { THRESHOLD_NONE, THRESHOLD_OTSU, THRESHOLD_ADAPTIVE };
+
+    int scale = 1;                          //Integer upscale factor (bilinear), ex: 2-3 for small UI fonts. Tesseract works best with ~20-30px tall capitals.
+    Threshold threshold = THRESHOLD_NONE;   //Binarize to black/white: one global level (Otsu) or a local mean per pixel (adaptive, for gradients/uneven backgrounds)
+    int adaptiveRadius = 8;                 //THRESHOLD_ADAPTIVE: half size of the averaging window, in (scaled) pixels
+    int adaptiveOffset = 8;                 //THRESHOLD_ADAPTIVE: how much darker than the local mean a pixel must be to count as text
+    int invert = 0;                         //Make the text dark on a light background: 1 = always invert, 0 = never, -1 = auto (if the image is mostly dark, ex: dark themes)
+    bool autoCrop = false;                  //Crop to the content (pixels differing from the background color). Blank images become empty and skip OCR entirely.
+    int cropTolerance = 32;                 //autoCrop: how far (0-255) a pixel must be from the background color to count as content
+    int cropMargin = 4;                     //autoCrop: pixels of background kept around the content
+
+    /// @return "" for the defaults, otherwise a short description of these options (used in OCR cache keys).
+    std::string toKey() const;
+};
+
+/// @brief Time spent in each preprocessing stage, in microseconds.
+struct OCRPreprocessTimings {
+    double grayUS = 0, invertUS = 0, cropUS = 0, scaleUS = 0, thresholdUS = 0;
+    double totalUS = 0;
+};
+
+/// @brief A preprocessed, single-channel (8-bit gray) image ready for OCR.
+struct OCRImage {
+    std::vector<uint8_t> pixels;    //'w' bytes per row
+    int w = 0; int h = 0;
+    nch::Rect crop;                 //Part of the source image that was kept (whole image if not cropped)
+    int scale = 1;                  //Each source pixel is 'scale'x'scale' pixels here
+    OCRPreprocessTimings timings;
+};
+
+class OCRPreprocess {
+public:
+    /// @brief Convert, clean up and scale a BGRA32 image for OCR: gray -> invert -> crop -> scale -> threshold (each stage optional except gray).
+    /// @param pixels BGRA32 pixels, 'pitch' bytes per row.
+    /// @return The processed image. Empty (w = h = 0) if the input is empty or 'autoCrop' found no content.
+    static OCRImage run(const uint8_t* pixels, int w, int h, int pitch, const OCRPreprocessOptions& opts);
+    /// @return The timings of the last 'run()' on the calling thread.
+    static OCRPreprocessTimings getLastTimings();
+
+    /// @brief Convert BGRA32 pixels to 8-bit grayscale (ITU-R BT.601 luma), 16 pixels at a time with SSE2 where available.
+    /// @param dst Output, 'w' bytes per row.
+    static void toGray(const uint8_t* pixels, int w, int h, int pitch, uint8_t* dst);
+    /// @return The gray level splitting 'hist' (256 bins) into two classes with the largest between-class variance (Otsu's method).
+    static int otsuLevel(const uint64_t* hist);
+private:
+    static void histogram(const std::vector<uint8_t>& gray, uint64_t* hist);
+    static void invert(std::vector<uint8_t>& gray);
+    static bool findContent(const std::vector<uint8_t>& gray, int w, int h, const uint64_t* hist, const OCRPreprocessOptions& opts, nch::Rect& res);
+    static std::vector<uint8_t> upscale(const std::vector<uint8_t>& src, int w, int h, int scale);
+    static void thresholdAdaptive(std::vector<uint8_t>& gray, int w, int h, int radius, int offset);
+};
+}
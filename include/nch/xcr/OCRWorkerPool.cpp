@@ -0,0 +1,10 @@
+#include "OCRWorkerPool.h"
+#include <algorithm>
+
+using namespace nch;
+
+WorkerQueue OCRWorkerPool::queue(0, &OCRWorkerPool::stop);
+
+void OCRWorkerPool::setNumWorkers(int num) { queue.setNumWorkers(std::max(1, num)); }
+int OCRWorkerPool::getNumWorkers() { return queue.getNumWorkers(); }
+void OCRWorkerPool::stop() { queue.stop(); }
@@ -0,0 +1,22 @@
+#pragma once
+#include <future>
+#include "WorkerQueue.h"
+
+namespace nch { class OCRWorkerPool {
+public:
+    /// @brief Queue 'task' to run on one of the pool's worker threads and return immediately.
+    /// @brief Workers are started on first use (see 'setNumWorkers()').
+    /// @return A future that becomes ready once 'task' has finished (holding its return value).
+    template<typename F> static auto submit(F task) -> std::future<decltype(task())> {
+        return queue.submit(task);
+    }
+
+    /// @brief Set the number of worker threads (default: number of CPU cores). Takes effect the next time the pool starts.
+    static void setNumWorkers(int numWorkers);
+    static int getNumWorkers();
+    /// @brief Finish every queued task, then stop all workers. Submitting again restarts them.
+    /// @brief Called by Xcalibur::free() and automatically at exit.
+    static void stop();
+private:
+    static WorkerQueue queue;   //As many workers as CPU cores unless set otherwise
+}; }
@@ -0,0 +1,156 @@
+#include "PointerSampler.h"
+#include <nch/cpp-utils/log.h>
+#include <stdlib.h>
+#include "InputScheduler.h"
+#include "XNativeInput.h"
+
+using namespace nch;
+
+Display* PointerSampler::disp = nullptr;
+std::thread PointerSampler::thread;
+std::atomic<bool> PointerSampler::running(false);
+std::mutex PointerSampler::mtx;
+std::atomic<PointerSampler::Ring*> PointerSampler::ring(nullptr);
+std::vector<std::unique_ptr<PointerSampler::Ring>> PointerSampler::rings;
+
+bool PointerSampler::queryPointer(Vec2i& res)
+{
+    Display* d = XNativeInput::getDisplay();
+    if(d==nullptr) return false;
+
+    Window rootRet, childRet;
+    int rootX, rootY, winX, winY;
+    unsigned int mask;
+    if(!XQueryPointer(d, DefaultRootWindow(d), &rootRet, &childRet, &rootX, &rootY, &winX, &winY, &mask)) return false;
+    res = Vec2i(rootX, rootY);
+    return true;
+}
+
+bool PointerSampler::start(int rateHz, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(running) return true;
+
+    disp = XOpenDisplay(NULL);
+    if(disp==nullptr) {
+        Log::error(__PRETTY_FUNCTION__, "Failed to open display...");
+        return false;
+    }
+
+    size_t cap = 1;
+    while(cap<capacity) cap <<= 1;
+    //Reuse the current ring if it has the right size, otherwise publish a new one (the old one stays alive for readers)
+    Ring* r = ring.load(std::memory_order_acquire);
+    if(r==nullptr || r->mask!=cap-1) {
+        rings.push_back(std::unique_ptr<Ring>(new Ring()));
+        r = rings.back().get();
+        r->slots.reset(new Slot[cap]);
+        r->mask = cap-1;
+    }
+    r->head.store(0, std::memory_order_release);
+    for(size_t i = 0; i<cap; i++) r->slots[i].seq.store(0, std::memory_order_release);
+    ring.store(r, std::memory_order_release);
+
+    running = true;
+    thread = std::thread(run, rateHz);
+    //A still-running std::thread would call std::terminate() when destroyed at exit
+    static bool stopRegistered = false;
+    if(!stopRegistered) {
+        std::atexit(stop);
+        stopRegistered = true;
+    }
+    return true;
+}
+
+void PointerSampler::stop()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!running) return;
+    running = false;
+    thread.join();
+    XCloseDisplay(disp);
+    disp = nullptr;
+}
+
+bool PointerSampler::isRunning() { return running; }
+
+bool PointerSampler::getLatest(PointerSample& res)
+{
+    Ring* r = ring.load(std::memory_order_acquire);
+    if(r==nullptr) return false;
+    //Retry if the writer lapped us while reading
+    for(int attempt = 0; attempt<4; attempt++) {
+        uint64_t h = r->head.load(std::memory_order_acquire);
+        if(h==0) return false;
+        if(readSlot(r, h-1, res)) return true;
+    }
+    return false;
+}
+
+std::vector<PointerSample> PointerSampler::getHistory(size_t maxSamples)
+{
+    std::vector<PointerSample> res;
+    Ring* r = ring.load(std::memory_order_acquire);
+    if(r==nullptr) return res;
+
+    uint64_t h = r->head.load(std::memory_order_acquire);
+    uint64_t n = std::min<uint64_t>(std::min<uint64_t>(maxSamples, h), r->mask+1);
+    res.reserve(n);
+    for(uint64_t i = h-n; i<h; i++) {
+        PointerSample s;
+        if(readSlot(r, i, s)) res.push_back(s);
+    }
+    return res;
+}
+
+void PointerSampler::run(int rateHz)
+{
+    int64_t periodNS = 1000000000LL/std::max(1, rateHz);
+    int64_t next = InputScheduler::nowNS();
+    Window root = DefaultRootWindow(disp);
+    Ring* r = ring.load(std::memory_order_acquire);
+
+    while(running) {
+        Window rootRet, childRet;
+        int rootX, rootY, winX, winY;
+        unsigned int mask;
+        if(XQueryPointer(disp, root, &rootRet, &childRet, &rootX, &rootY, &winX, &winY, &mask)) {
+            PointerSample s;
+            s.x = rootX; s.y = rootY;
+            s.tNS = InputScheduler::nowNS();
+            publish(r, s);
+        }
+
+        next += periodNS;
+        //Don't try to catch up on missed samples after a stall
+        int64_t now = InputScheduler::nowNS();
+        if(next<now) next = now;
+        InputScheduler::sleepUntilNS(next);
+    }
+}
+
+void PointerSampler::publish(Ring* r, const PointerSample& s)
+{
+    //Single writer: mark the slot as being written, fill it in, then mark it complete and advance 'head'
+    uint64_t index = r->head.load(std::memory_order_relaxed);
+    Slot& slot = r->slots[index&r->mask];
+    slot.seq.store(2*index+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.x.store(s.x, std::memory_order_relaxed);
+    slot.y.store(s.y, std::memory_order_relaxed);
+    slot.tNS.store(s.tNS, std::memory_order_relaxed);
+    slot.seq.store(2*index+2, std::memory_order_release);
+    r->head.store(index+1, std::memory_order_release);
+}
+
+bool PointerSampler::readSlot(Ring* r, uint64_t index, PointerSample& res)
+{
+    Slot& slot = r->slots[index&r->mask];
+    uint64_t seq0 = slot.seq.load(std::memory_order_acquire);
+    if(seq0!=2*index+2) return false;
+    res.x = slot.x.load(std::memory_order_relaxed);
+    res.y = slot.y.load(std::memory_order_relaxed);
+    res.tNS = slot.tNS.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed)==seq0;
+}
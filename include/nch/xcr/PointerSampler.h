@@ -0,0 +1,57 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <nch/math-utils/vec2.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace nch {
+/// @brief Pointer position at CLOCK_MONOTONIC time 'tNS' (nanoseconds, see InputScheduler::nowNS()).
+struct PointerSample { int x = -1; int y = -1; int64_t tNS = 0; };
+
+class PointerSampler {
+public:
+    /// @brief Get the absolute pointer position with a single XQueryPointer round-trip.
+    /// @return False if there is no display (or the pointer is on another screen).
+    static bool queryPointer(nch::Vec2i& res);
+
+    /// @brief Start sampling the pointer on a dedicated thread and display connection, publishing samples into a lock-free ring.
+    /// @param rateHz Samples per second.
+    /// @param capacity Number of samples kept in the ring (rounded up to a power of 2).
+    /// @return True if the sampler is running (or already was).
+    static bool start(int rateHz = 1000, size_t capacity = 4096);
+    /// @brief Stop sampling. Called by Xcalibur::free() and automatically at exit. Samples published so far stay readable.
+    static void stop();
+    static bool isRunning();
+
+    /// @brief Get the most recent sample without any X round-trip. Safe to call from any thread.
+    /// @return False if no sample has been published yet.
+    static bool getLatest(PointerSample& res);
+    /// @brief Get up to 'maxSamples' of the most recent samples, oldest first. Safe to call from any thread.
+    static std::vector<PointerSample> getHistory(size_t maxSamples);
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;  //2*index+1 while being written, 2*index+2 once complete
+        std::atomic<int> x, y;
+        std::atomic<int64_t> tNS;
+    };
+    struct Ring {
+        std::unique_ptr<Slot[]> slots;
+        uint64_t mask = 0;                  //Capacity-1
+        std::atomic<uint64_t> head;         //Number of samples ever published
+    };
+    static void run(int rateHz);
+    static void publish(Ring* r, const PointerSample& s);
+    static bool readSlot(Ring* r, uint64_t index, PointerSample& res);
+
+    static Display* disp;
+    static std::thread thread;
+    static std::atomic<bool> running;
+    static std::mutex mtx;                  //Serializes start() and stop()
+    //Readers may still be using a ring when the sampler restarts: rings are published atomically and only freed at exit
+    static std::atomic<Ring*> ring;
+    static std::vector<std::unique_ptr<Ring>> rings;
+}; }
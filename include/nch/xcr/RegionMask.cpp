@@ -0,0 +1,188 @@
+#include "RegionMask.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace nch;
+
+RegionMask::RegionMask(){}
+RegionMask::RegionMask(int w, int h, bool full) {
+    reset(w, h, full);
+}
+
+void RegionMask::reset(int w, int h, bool full)
+{
+    if(w<0) w = 0;
+    if(h<0) h = 0;
+    RegionMask::w = w;
+    RegionMask::h = h;
+
+    rows.assign(h, std::vector<RegionSpan>());
+    if(full && w>0) {
+        for(int y = 0; y<h; y++) rows[y].push_back({0, w});
+    }
+}
+
+void RegionMask::addRect(const Rect& r, Mode mode)
+{
+    int y0 = std::max(r.r.y, 0);
+    int y1 = std::min(r.r.y+r.r.h, h);
+    for(int y = y0; y<y1; y++) {
+        applySpan(y, r.r.x, r.r.x+r.r.w, mode);
+    }
+}
+
+void RegionMask::addPolygon(const std::vector<Vec2i>& pts, Mode mode)
+{
+    if(pts.size()<3) return;
+
+    //Vertical extent of the polygon, clipped to the mask
+    int minY = pts[0].y, maxY = pts[0].y;
+    for(size_t i = 1; i<pts.size(); i++) {
+        minY = std::min(minY, pts[i].y);
+        maxY = std::max(maxY, pts[i].y);
+    }
+    minY = std::max(minY, 0);
+    maxY = std::min(maxY, h);
+
+    //Scanline fill: intersect every edge with the center of each row, then fill between pairs of crossings
+    std::vector<double> xs;
+    for(int y = minY; y<maxY; y++) {
+        double cy = y+0.5;
+        xs.clear();
+        for(size_t i = 0; i<pts.size(); i++) {
+            const Vec2i& a = pts[i];
+            const Vec2i& b = pts[(i+1)%pts.size()];
+            if((a.y<=cy && b.y>cy) || (b.y<=cy && a.y>cy)) {
+                xs.push_back(a.x+(cy-a.y)*(b.x-a.x)/(double)(b.y-a.y));
+            }
+        }
+        std::sort(xs.begin(), xs.end());
+        for(size_t i = 0; i+1<xs.size(); i += 2) {
+            int x0 = (int)std::ceil(xs[i]-0.5);
+            int x1 = (int)std::ceil(xs[i+1]-0.5);
+            applySpan(y, x0, x1, mode);
+        }
+    }
+}
+
+void RegionMask::addBitmap(const uint8_t* bits, int bw, int bh, int pitch, const Vec2i& origin, Mode mode)
+{
+    if(bits==nullptr) return;
+
+    for(int by = 0; by<bh; by++) {
+        int y = origin.y+by;
+        if(y<0 || y>=h) continue;
+
+        //Turn every run of nonzero bytes into one span
+        const uint8_t* row = bits+by*pitch;
+        int bx = 0;
+        while(bx<bw) {
+            while(bx<bw && row[bx]==0) bx++;
+            int runStart = bx;
+            while(bx<bw && row[bx]!=0) bx++;
+            if(bx>runStart) {
+                applySpan(y, origin.x+runStart, origin.x+bx, mode);
+            }
+        }
+    }
+}
+
+const std::vector<RegionSpan>& RegionMask::getRowSpans(int y) const {
+    static const std::vector<RegionSpan> empty;
+    if(y<0 || y>=h) return empty;
+    return rows[y];
+}
+int RegionMask::getWidth() const { return w; }
+int RegionMask::getHeight() const { return h; }
+
+bool RegionMask::contains(int x, int y) const
+{
+    if(y<0 || y>=h) return false;
+    const std::vector<RegionSpan>& row = rows[y];
+    for(size_t i = 0; i<row.size(); i++) {
+        if(x<row[i].x0) return false;
+        if(x<row[i].x1) return true;
+    }
+    return false;
+}
+
+uint64_t RegionMask::countPixels() const
+{
+    uint64_t res = 0;
+    forEachSpan([&](int y, int x0, int x1) { res += (x1-x0); });
+    return res;
+}
+
+std::vector<Rect> RegionMask::toRects(bool inverted) const
+{
+    std::vector<Rect> res;
+
+    //Get spans of a given row (or the gaps between them if 'inverted')
+    std::vector<RegionSpan> prev, cur;
+    auto getSpans = [&](int y, std::vector<RegionSpan>& out) {
+        out.clear();
+        if(!inverted) { out = rows[y]; return; }
+        int x = 0;
+        for(size_t i = 0; i<rows[y].size(); i++) {
+            if(rows[y][i].x0>x) out.push_back({x, rows[y][i].x0});
+            x = rows[y][i].x1;
+        }
+        if(x<w) out.push_back({x, w});
+    };
+    auto sameSpans = [](const std::vector<RegionSpan>& a, const std::vector<RegionSpan>& b) {
+        if(a.size()!=b.size()) return false;
+        for(size_t i = 0; i<a.size(); i++) {
+            if(a[i].x0!=b[i].x0 || a[i].x1!=b[i].x1) return false;
+        }
+        return true;
+    };
+
+    //Merge consecutive rows with identical spans into one band of rectangles
+    int bandStart = 0;
+    for(int y = 0; y<=h; y++) {
+        if(y<h) getSpans(y, cur);
+        if(y==h || (y>0 && !sameSpans(prev, cur))) {
+            for(size_t i = 0; i<prev.size(); i++) {
+                res.push_back(Rect(prev[i].x0, bandStart, prev[i].x1-prev[i].x0, y-bandStart));
+            }
+            bandStart = y;
+        }
+        std::swap(prev, cur);
+    }
+    return res;
+}
+
+void RegionMask::applySpan(int y, int x0, int x1, Mode mode)
+{
+    //Clip to mask
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, w);
+    if(x0>=x1) return;
+
+    std::vector<RegionSpan>& row = rows[y];
+    std::vector<RegionSpan> res;
+    res.reserve(row.size()+1);
+
+    if(mode==INCLUDE) {
+        //Union: merge [x0, x1) with every span it overlaps or touches
+        size_t i = 0;
+        for(; i<row.size() && row[i].x1<x0; i++) res.push_back(row[i]);
+        RegionSpan merged = {x0, x1};
+        for(; i<row.size() && row[i].x0<=x1; i++) {
+            merged.x0 = std::min(merged.x0, row[i].x0);
+            merged.x1 = std::max(merged.x1, row[i].x1);
+        }
+        res.push_back(merged);
+        for(; i<row.size(); i++) res.push_back(row[i]);
+    } else {
+        //Difference: cut [x0, x1) out of every span
+        for(size_t i = 0; i<row.size(); i++) {
+            const RegionSpan& s = row[i];
+            if(s.x1<=x0 || s.x0>=x1) { res.push_back(s); continue; }
+            if(s.x0<x0) res.push_back({s.x0, x0});
+            if(s.x1>x1) res.push_back({x1, s.x1});
+        }
+    }
+
+    row.swap(res);
+}
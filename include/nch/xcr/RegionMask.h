@@ -0,0 +1,61 @@
+#pragma once
+#include <nch/math-utils/vec2.h>
+#include <nch/sdl-utils/rect.h>
+#include <stdint.h>
+#include <vector>
+
+namespace nch {
+/// @brief A horizontal run of pixels [x0, x1) within a single row of a RegionMask.
+struct RegionSpan { int x0; int x1; };
+
+class RegionMask {
+public:
+    enum Mode { INCLUDE, EXCLUDE };
+
+    RegionMask();
+    /// @brief Create a mask covering a 'w' by 'h' area, where every pixel starts out included (full=true) or excluded (full=false).
+    RegionMask(int w, int h, bool full);
+
+    /// @brief Resize the mask and set every pixel to included (full=true) or excluded (full=false). Costs O(rows).
+    void reset(int w, int h, bool full);
+
+    /// @brief Include or exclude a rectangle (x, y, w, h) from the mask. Costs O(rows) - the opposite 'mode' undoes it.
+    /// @param r The rectangular area, in mask coordinates.
+    /// @param mode INCLUDE to add the pixels of 'r' to the mask, EXCLUDE to remove them.
+    void addRect(const nch::Rect& r, Mode mode);
+    /// @brief Include or exclude the inside of a polygon (even-odd rule, sampled at pixel centers).
+    /// @param pts The vertices of the polygon in order. The last vertex is implicitly connected to the first.
+    /// @param mode INCLUDE to add the pixels of the polygon to the mask, EXCLUDE to remove them.
+    void addPolygon(const std::vector<nch::Vec2i>& pts, Mode mode);
+    /// @brief Include or exclude every nonzero pixel of an 8-bit bitmap.
+    /// @param bits Bitmap data, one byte per pixel.
+    /// @param bw Width of the bitmap. @param bh Height of the bitmap. @param pitch Number of bytes between rows of 'bits'.
+    /// @param origin Position of the bitmap's top left pixel within the mask.
+    /// @param mode INCLUDE to add the pixels to the mask, EXCLUDE to remove them.
+    void addBitmap(const uint8_t* bits, int bw, int bh, int pitch, const nch::Vec2i& origin, Mode mode);
+
+    /// @return The sorted, non-overlapping spans of included pixels within row 'y'.
+    const std::vector<RegionSpan>& getRowSpans(int y) const;
+    int getWidth() const; int getHeight() const;
+    /// @return Whether the pixel at (x, y) is included in the mask.
+    bool contains(int x, int y) const;
+    /// @return The total number of included pixels.
+    uint64_t countPixels() const;
+    /// @brief Build a list of rectangles that exactly covers the mask by merging vertically adjacent rows with identical spans.
+    /// @param inverted If true, cover the excluded pixels instead of the included ones.
+    std::vector<nch::Rect> toRects(bool inverted = false) const;
+
+    /// @brief Call 'f(y, x0, x1)' for every span of included pixels, top to bottom and left to right.
+    template<typename F> void forEachSpan(F f) const {
+        for(int y = 0; y<h; y++) {
+            const std::vector<RegionSpan>& row = rows[y];
+            for(size_t i = 0; i<row.size(); i++) f(y, row[i].x0, row[i].x1);
+        }
+    }
+private:
+    void applySpan(int y, int x0, int x1, Mode mode);
+
+    int w = 0; int h = 0;
+    std::vector<std::vector<RegionSpan>> rows;
+};
+}
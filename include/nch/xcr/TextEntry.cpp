@@ -0,0 +1,168 @@
+#include "TextEntry.h"
+#include <nch/cpp-utils/string-utils.h>
+#include <nch/cpp-utils/timer.h>
+#include "MiscTools.h"
+#include "Xcalibur.h"
+#include "XWindowCache.h"
+#include "XWindowQuery.h"
+
+using namespace nch;
+
+std::mutex TextEntry::mtx;
+std::map<std::string, TextEntryPolicy> TextEntry::targetPolicies;
+TextEntryPolicy TextEntry::defaultPolicy;
+
+TextEntryResult TextEntry::enterText(const std::string& text, const TextEntryPolicy& policy)
+{
+    TextEntryResult res;
+    int64_t t0 = InputScheduler::nowNS();
+    res.strategy = pickStrategy(text, policy);
+
+    //Remember what the verification area looks like beforehand
+    bool verify = policy.verifyArea.r.w>0 && policy.verifyArea.r.h>0 && Xcalibur::getOpenedDisplay()!=nullptr;
+    uint64_t hashBefore = 0;
+    if(verify) {
+        Xcalibur::updateScreenSurf();
+        hashBefore = Xcalibur::getDisplayAreaHash(policy.verifyArea);
+    }
+
+    /* Enter the text */
+    switch(res.strategy) {
+        case TextEntryPolicy::PASTE: {
+            paste(text, policy);
+            res.numPastedBytes = text.size();
+        } break;
+        case TextEntryPolicy::MIXED: {
+            //Split into runs of regular text (pasted if long enough, typed otherwise) and characters that must be typed
+            uint64_t seed = policy.seed;
+            bool pastedLast = false;
+            size_t i = 0;
+            while(i<text.size()) {
+                size_t j = i;
+                if(policy.typedChars.find(text[i])!=std::string::npos) j++;
+                else while(j<text.size() && policy.typedChars.find(text[j])==std::string::npos) j++;
+
+                std::string run = text.substr(i, j-i);
+                bool forceTyped = (j==i+1 && policy.typedChars.find(text[i])!=std::string::npos);
+                bool pasteRun = !forceTyped && run.size()>=policy.pasteMinLength;
+                //Give the target time to fetch the pasted clipboard contents before they are replaced, or before typed keys (ex: Enter) overtake them
+                if(pastedLast) Timer::sleep(policy.pasteSettleMS);
+                if(pasteRun) {
+                    paste(run, policy);
+                    res.numPastedBytes += run.size();
+                } else {
+                    type(run, policy, seed++);
+                    res.numTypedChars += run.size();
+                }
+                pastedLast = pasteRun;
+                i = j;
+            }
+        } break;
+        default: {
+            type(text, policy, policy.seed);
+            res.numTypedChars = text.size();
+        } break;
+    }
+
+    /* Confirm that it landed */
+    if(verify) res.verified = verifyLanded(text, policy, hashBefore);
+
+    res.elapsedMS = (InputScheduler::nowNS()-t0)/1000000.0;
+    return res;
+}
+
+TextEntryResult TextEntry::enterText(const std::string& text)
+{
+    //Find the class name of the active window
+    std::string className;
+    CachedWindow cw;
+    if(XWindowCache::isRunning()) {
+        if(XWindowCache::getWindow(XWindowCache::getActiveWindow(), cw)) className = cw.className;
+    } else {
+        Window active = XWindowQuery::getActiveWindow();
+        if(active!=None) className = XWindowQuery::getWindowClassName(active);
+    }
+
+    TextEntryPolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto itr = targetPolicies.find(className);
+        policy = (itr!=targetPolicies.end()) ? itr->second : defaultPolicy;
+    }
+    return enterText(text, policy);
+}
+
+void TextEntry::setTargetPolicy(const std::string& className, const TextEntryPolicy& policy)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    targetPolicies[className] = policy;
+}
+void TextEntry::setDefaultPolicy(const TextEntryPolicy& policy)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    defaultPolicy = policy;
+}
+
+TextEntryPolicy::Strategy TextEntry::pickStrategy(const std::string& text, const TextEntryPolicy& policy)
+{
+    if(policy.strategy!=TextEntryPolicy::AUTO) return policy.strategy;
+
+    bool nonAscii = false, hasTypedChars = false;
+    for(size_t i = 0; i<text.size(); i++) {
+        if((uint8_t)text[i]>=0x80) nonAscii = true;
+        if(policy.typedChars.find(text[i])!=std::string::npos) hasTypedChars = true;
+    }
+
+    //Short text: a couple of keystrokes are cheaper than a clipboard round-trip (and don't clobber the clipboard)
+    if(text.size()<policy.pasteMinLength && !(nonAscii && policy.pasteNonAscii)) return TextEntryPolicy::KEYSTROKES;
+    if(hasTypedChars) return TextEntryPolicy::MIXED;
+    return TextEntryPolicy::PASTE;
+}
+
+bool TextEntry::verifyLanded(const std::string& text, const TextEntryPolicy& policy, uint64_t hashBefore)
+{
+    //What to look for with OCR: the last non-empty line, which is the one nearest to the caret
+    std::string needle;
+    if(policy.verifyText) {
+        std::vector<std::string> lines = StringUtils::split(text, '\n');
+        for(size_t i = lines.size(); i-->0 && needle==""; ) {
+            if(lines[i].find_first_not_of(" \t\r")!=std::string::npos) needle = lines[i];
+        }
+    }
+
+    //A change only counts once the area stays in the new state for 'verifyStableMS': a caret blink or hover effect flickers back
+    int64_t deadline = InputScheduler::nowNS()+(int64_t)policy.verifyTimeoutMS*1000000LL;
+    uint64_t candidate = hashBefore, checked = hashBefore;
+    int64_t candidateSince = 0;
+    do {
+        Xcalibur::updateScreenSurf();
+        uint64_t hash = Xcalibur::getDisplayAreaHash(policy.verifyArea);
+        int64_t now = InputScheduler::nowNS();
+        if(hash!=candidate) {
+            candidate = hash;
+            candidateSince = now;
+        } else if(hash!=hashBefore && hash!=checked && now-candidateSince>=(int64_t)policy.verifyStableMS*1000000LL) {
+            //Settled into a new state: check its contents (once per state)
+            checked = hash;
+            if(needle=="") return true;
+            OCRSearchOptions opts;
+            opts.maxEdits = policy.verifyMaxEdits;
+            if(!MiscTools::displayOCRIndex(policy.verifyArea).find(needle, opts).empty()) return true;
+        }
+        Timer::sleep(5);
+    } while(InputScheduler::nowNS()<deadline);
+    return false;
+}
+
+void TextEntry::paste(const std::string& text, const TextEntryPolicy& policy)
+{
+    MiscTools::lcSetClipboard(text);
+    InputScript script;
+    script.keyDown(policy.pasteKeys).keyUp(policy.pasteKeys, 20);
+    InputScheduler::run(script);
+}
+
+void TextEntry::type(const std::string& text, const TextEntryPolicy& policy, uint64_t seed)
+{
+    InputScheduler::run(InputScript::typing(text, seed, policy.keyDownDist, policy.keyUpDist));
+}
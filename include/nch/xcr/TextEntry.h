@@ -0,0 +1,58 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include "InputScheduler.h"
+
+namespace nch {
+/// @brief How TextEntry should enter text into a given target.
+struct TextEntryPolicy {
+    enum Strategy { AUTO, PASTE, KEYSTROKES, MIXED };
+    Strategy strategy = AUTO;
+    size_t pasteMinLength = 24;         //AUTO/MIXED: runs of text at least this long are pasted, shorter ones are typed
+    std::string typedChars = "\n\t";    //MIXED (and AUTO): characters that are always sent as keystrokes (ex: newline submitting a form)
+    bool pasteNonAscii = true;          //AUTO: paste any text containing non-ASCII characters, regardless of length
+    std::string pasteKeys = "ctrl+v";   //Key sequence that pastes in the target (ex: "ctrl+shift+v" for terminals)
+    int pasteSettleMS = 50;             //MIXED: wait this long after a paste before the next run (typed or pasted) is sent
+    DelayDistribution keyDownDist = InputScript::uniformDelay(15, 30);
+    DelayDistribution keyUpDist = InputScript::uniformDelay(35, 90);
+    uint64_t seed = 0;
+
+    nch::Rect verifyArea = nch::Rect(0, 0, 0, 0);   //If not empty: area of the Xcalibur display that must change once the text lands
+    int verifyTimeoutMS = 1000;
+    int verifyStableMS = 100;   //The changed area must then stay unchanged this long (a caret blink or hover effect flickers back)
+    bool verifyText = false;    //Also require OCR of the settled area to find the last line of the text (see 'verifyMaxEdits'). Slower, but a blink slower than 'verifyStableMS' can't fool it.
+    int verifyMaxEdits = 2;     //'verifyText': characters OCR may get wrong (OCRSearchOptions::maxEdits)
+};
+
+/// @brief What TextEntry actually did.
+struct TextEntryResult {
+    TextEntryPolicy::Strategy strategy = TextEntryPolicy::AUTO;   //Strategy picked (never AUTO)
+    size_t numPastedBytes = 0;
+    size_t numTypedChars = 0;
+    bool verified = false;      //True if 'verifyArea' settled into a changed state (with the text in it, if 'verifyText') within 'verifyTimeoutMS'. Always false without a 'verifyArea'.
+    double elapsedMS = 0;
+};
+
+class TextEntry {
+public:
+    /// @brief Enter UTF-8 'text' into the focused window using the cheapest safe strategy allowed by 'policy':
+    /// @brief clipboard paste (MiscTools::lcSetClipboard + 'pasteKeys'), native keystrokes, or a mix of both.
+    static TextEntryResult enterText(const std::string& text, const TextEntryPolicy& policy);
+    /// @brief Same as above, using the policy registered for the active window's class name (or the default policy).
+    static TextEntryResult enterText(const std::string& text);
+
+    /// @brief Register the policy to use for windows whose class name (WM_CLASS instance name) is 'className'.
+    static void setTargetPolicy(const std::string& className, const TextEntryPolicy& policy);
+    static void setDefaultPolicy(const TextEntryPolicy& policy);
+private:
+    static TextEntryPolicy::Strategy pickStrategy(const std::string& text, const TextEntryPolicy& policy);
+    static bool verifyLanded(const std::string& text, const TextEntryPolicy& policy, uint64_t hashBefore);
+    static void paste(const std::string& text, const TextEntryPolicy& policy);
+    static void type(const std::string& text, const TextEntryPolicy& policy, uint64_t seed);
+
+    static std::mutex mtx;
+    static std::map<std::string, TextEntryPolicy> targetPolicies;
+    static TextEntryPolicy defaultPolicy;
+}; }
@@ -0,0 +1,186 @@
+#include "WaitFor.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <nch/cpp-utils/log.h>
+#include <nch/cpp-utils/timer.h>
+#include <stdlib.h>
+#include "InputScheduler.h"
+#include "Xcalibur.h"
+#include "XWindowQuery.h"
+
+using namespace nch;
+
+bool WaitFor::window(Window win, const std::function<bool(const CachedWindow&)>& pred, int timeoutMS)
+{
+    return windowCondition([win, &pred]() {
+        CachedWindow cw;
+        return getWindow(win, cw) && pred(cw);
+    }, timeoutMS);
+}
+bool WaitFor::windowMapped(Window win, int timeoutMS, bool mapped) {
+    return window(win, [mapped](const CachedWindow& cw) { return cw.mapped==mapped; }, timeoutMS);
+}
+bool WaitFor::windowMoved(Window win, const Rect& from, int timeoutMS) {
+    return window(win, [from](const CachedWindow& cw) { return cw.rect.r.x!=from.r.x || cw.rect.r.y!=from.r.y; }, timeoutMS);
+}
+bool WaitFor::windowResized(Window win, const Rect& from, int timeoutMS) {
+    return window(win, [from](const CachedWindow& cw) { return cw.rect.r.w!=from.r.w || cw.rect.r.h!=from.r.h; }, timeoutMS);
+}
+bool WaitFor::windowFocused(Window win, int timeoutMS) {
+    return windowCondition([win]() {
+        return (XWindowCache::isRunning() ? XWindowCache::getActiveWindow() : XWindowQuery::getActiveWindow())==win;
+    }, timeoutMS);
+}
+
+bool WaitFor::regionStable(const Rect& area, int stableMS, int timeoutMS, int pollMS)
+{
+    std::vector<uint32_t> prev, cur;
+    if(!Xcalibur::captureDisplayArea(area, prev)) return false;
+
+    int64_t now = InputScheduler::nowNS();
+    int64_t deadline = now+(int64_t)timeoutMS*1000000LL;
+    int64_t lastChange = now;
+    while(true) {
+        if(now-lastChange>=(int64_t)stableMS*1000000LL) return true;
+        if(now>=deadline) return false;
+
+        Timer::sleep(pollMS);
+        if(!Xcalibur::captureDisplayArea(area, cur)) return false;
+        now = InputScheduler::nowNS();
+        if(cur!=prev) {
+            prev.swap(cur);
+            lastChange = now;
+        }
+    }
+}
+
+bool WaitFor::pixelEquals(const Vec2i& pos, const Color& color, int timeoutMS, int tolerance, int pollMS)
+{
+    uint32_t target = (color.r<<16)|(color.g<<8)|color.b;
+    std::vector<uint32_t> pix;
+    int64_t deadline = InputScheduler::nowNS()+(int64_t)timeoutMS*1000000LL;
+    while(true) {
+        if(!Xcalibur::captureDisplayArea(Rect(pos.x, pos.y, 1, 1), pix)) return false;
+        if(pixelMatches(pix[0], target, tolerance)) return true;
+        if(InputScheduler::nowNS()>=deadline) return false;
+        Timer::sleep(pollMS);
+    }
+}
+
+bool WaitFor::templateAppears(const Rect& area, SDL_Surface* tmpl, int timeoutMS, Vec2i* foundPos, int tolerance, int pollMS)
+{
+    if(tmpl==nullptr) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "'tmpl' is NULL");
+        return false;
+    }
+
+    /* Template pixels in the same format as the captured pixels (BGRA32) */
+    SDL_Surface* conv = SDL_ConvertSurfaceFormat(tmpl, SDL_PIXELFORMAT_BGRA32, 0);
+    if(conv==NULL) {
+        Log::errorv(__PRETTY_FUNCTION__, "SDL_ConvertSurfaceFormat()", SDL_GetError());
+        return false;
+    }
+    int tw = conv->w, th = conv->h;
+    std::vector<uint32_t> tpx((size_t)tw*th);
+    std::vector<int> opaque;    //Indices of the pixels that have to match
+    std::map<uint32_t, int> colorCounts;
+    for(int y = 0; y<th; y++) {
+        const uint32_t* row = (const uint32_t*)((uint8_t*)conv->pixels+y*conv->pitch);
+        for(int x = 0; x<tw; x++) {
+            tpx[y*tw+x] = row[x];
+            if((row[x]>>24)!=0) { opaque.push_back(y*tw+x); colorCounts[row[x]]++; }
+        }
+    }
+    SDL_FreeSurface(conv);
+
+    //Compare the rarest colors first: on a plain background, a position is rejected on its first pixel instead of after a run of background-colored ones
+    std::stable_sort(opaque.begin(), opaque.end(), [&](int a, int b) { return colorCounts.at(tpx[a])<colorCounts.at(tpx[b]); });
+
+    /* Same clipping as Xcalibur::captureDisplayArea() */
+    Rect disp = Xcalibur::getCapturedScreenRect();
+    int x0 = std::max(area.r.x, 0), x1 = std::min(area.r.x+area.r.w, disp.r.w);
+    int y0 = std::max(area.r.y, 0), y1 = std::min(area.r.y+area.r.h, disp.r.h);
+    int w = x1-x0, h = y1-y0;
+    if(tw>w || th>h) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "'tmpl' is larger than 'area'");
+        return false;
+    }
+    //Offset of each opaque pixel within the captured area, relative to the candidate position
+    std::vector<size_t> offsets(opaque.size());
+    for(size_t i = 0; i<opaque.size(); i++) offsets[i] = (size_t)(opaque[i]/tw)*w+opaque[i]%tw;
+
+    /* Search every capture until the template is found */
+    std::vector<uint32_t> pix;
+    int64_t deadline = InputScheduler::nowNS()+(int64_t)timeoutMS*1000000LL;
+    for(bool first = true; ; first = false) {
+        int64_t passStart = InputScheduler::nowNS();
+        if(!Xcalibur::captureDisplayArea(area, pix)) return false;
+        for(int oy = 0; oy<=h-th; oy++) {
+            //Only the first search runs to completion, later ones stop once the time is up
+            if(!first && InputScheduler::nowNS()>=deadline) return false;
+            for(int ox = 0; ox<=w-tw; ox++) {
+                const uint32_t* base = pix.data()+(size_t)oy*w+ox;
+                bool match = true;
+                for(size_t i = 0; i<opaque.size() && match; i++) {
+                    match = pixelMatches(base[offsets[i]], tpx[opaque[i]], tolerance);
+                }
+                if(match) {
+                    if(foundPos!=nullptr) *foundPos = Vec2i(x0+ox, y0+oy);
+                    return true;
+                }
+            }
+        }
+        int64_t now = InputScheduler::nowNS();
+        if(now>=deadline) return false;
+        //The search already used up part of the poll period
+        int64_t leftMS = pollMS-(now-passStart)/1000000LL;
+        if(leftMS>0) Timer::sleep((int)leftMS);
+    }
+}
+
+bool WaitFor::windowCondition(const std::function<bool()>& cond, int timeoutMS, int pollMS)
+{
+    int64_t deadline = InputScheduler::nowNS()+(int64_t)timeoutMS*1000000LL;
+
+    //No window cache running: poll with plain queries (the cache is only ever started by the caller)
+    if(!XWindowCache::isRunning()) {
+        while(true) {
+            if(cond()) return true;
+            if(InputScheduler::nowNS()>=deadline) return false;
+            Timer::sleep(pollMS);
+        }
+    }
+
+    //Read the generation before checking, so that a change in between wakes us up right away
+    uint64_t gen = XWindowCache::getGeneration();
+    while(true) {
+        if(cond()) return true;
+        int64_t left = deadline-InputScheduler::nowNS();
+        if(left<=0) return false;
+        if(!XWindowCache::isRunning()) return windowCondition(cond, (int)std::ceil(left/1000000.0), pollMS);
+        XWindowCache::waitForChange(gen, (int)std::ceil(left/1000000.0));
+    }
+}
+
+bool WaitFor::getWindow(Window win, CachedWindow& res)
+{
+    if(XWindowCache::isRunning()) return XWindowCache::getWindow(win, res);
+
+    if(!XWindowQuery::getWindowRect(win, res.rect)) return false;
+    res.id = win;
+    res.title = XWindowQuery::getWindowTitle(win);
+    res.className = XWindowQuery::getWindowClassName(win);
+    res.mapped = XWindowQuery::isWindowViewable(win);
+    res.stackIndex = -1;
+    return true;
+}
+
+bool WaitFor::pixelMatches(uint32_t pix, uint32_t target, int tolerance)
+{
+    if(tolerance<=0) return (pix&0x00ffffff)==(target&0x00ffffff);
+    for(int shift = 0; shift<24; shift += 8) {
+        if(abs((int)((pix>>shift)&0xff)-(int)((target>>shift)&0xff))>tolerance) return false;
+    }
+    return true;
+}
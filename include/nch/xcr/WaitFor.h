@@ -0,0 +1,47 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <X11/Xlib.h>
+#include <functional>
+#include <nch/cpp-utils/color.h>
+#include <nch/math-utils/vec2.h>
+#include <nch/sdl-utils/rect.h>
+#include "XWindowCache.h"
+
+namespace nch { class WaitFor {
+public:
+    /* Window conditions */
+    /// If XWindowCache is running, window conditions are driven by its X events: the caller sleeps until a relevant event arrives
+    /// and wakes up as soon as the condition holds. Otherwise they are polled with plain queries (XWindowQuery) every few milliseconds.
+    /// 'win' must be a top-level (client) window.
+    /// @brief Wait until 'pred' holds for the window 'win'. 'pred' is also checked once right away.
+    /// @return True if the condition held within 'timeoutMS', false on timeout.
+    static bool window(Window win, const std::function<bool(const CachedWindow&)>& pred, int timeoutMS);
+    /// @brief Wait until 'win' is mapped (mapped=true) or unmapped (mapped=false).
+    static bool windowMapped(Window win, int timeoutMS, bool mapped = true);
+    /// @brief Wait until the position of 'win' differs from that of 'from' (ex: the rect before a move request).
+    static bool windowMoved(Window win, const nch::Rect& from, int timeoutMS);
+    /// @brief Wait until the size of 'win' differs from that of 'from' (ex: the rect before a resize request).
+    static bool windowResized(Window win, const nch::Rect& from, int timeoutMS);
+    /// @brief Wait until 'win' is the active window (_NET_ACTIVE_WINDOW).
+    static bool windowFocused(Window win, int timeoutMS);
+    /// @brief Wait until 'cond' holds, re-checking it every time XWindowCache sees an X event (ex: for properties it doesn't cache, like _NET_WM_STATE),
+    /// @brief or every 'pollMS' milliseconds if the cache isn't running.
+    static bool windowCondition(const std::function<bool()>& cond, int timeoutMS, int pollMS = 5);
+
+    /* Screen conditions */
+    /// Screen conditions sample only the area they need (Xcalibur::captureDisplayArea()) back-to-back, 'pollMS' apart.
+    /// Xcalibur must be initialized. All coordinates are relative to Xcalibur's 'dispArea'.
+    /// @brief Wait until 'area' hasn't changed for 'stableMS' milliseconds (ex: an animation or page load finished).
+    static bool regionStable(const nch::Rect& area, int stableMS, int timeoutMS, int pollMS = 2);
+    /// @brief Wait until the pixel at 'pos' has the color 'color' (alpha ignored), within 'tolerance' per channel.
+    static bool pixelEquals(const nch::Vec2i& pos, const nch::Color& color, int timeoutMS, int tolerance = 0, int pollMS = 2);
+    /// @brief Wait until the image 'tmpl' appears anywhere within 'area' (every channel within 'tolerance').
+    /// @brief Fully transparent pixels of 'tmpl' (alpha==0) match anything.
+    /// @brief Each check is a brute-force search costing up to (area pixels) x (template pixels), though most positions are rejected after 1-2 pixels.
+    /// @brief Keep 'area' and 'tmpl' small: the first check always runs to completion, later ones give up as soon as 'timeoutMS' is over.
+    /// @param foundPos If not nullptr, receives the top-left position (relative to 'dispArea') where 'tmpl' was found.
+    static bool templateAppears(const nch::Rect& area, SDL_Surface* tmpl, int timeoutMS, nch::Vec2i* foundPos = nullptr, int tolerance = 0, int pollMS = 2);
+private:
+    static bool getWindow(Window win, CachedWindow& res);
+    static bool pixelMatches(uint32_t pix, uint32_t target, int tolerance);
+}; }
@@ -0,0 +1,103 @@
+#include "WorkerQueue.h"
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace nch;
+
+thread_local const WorkerQueue* WorkerQueue::currentQueue = nullptr;
+
+WorkerQueue::WorkerQueue(int numWorkers, void (*stopAtExit)()): numWorkers(std::max(0, numWorkers)), stopAtExit(stopAtExit) {}
+WorkerQueue::~WorkerQueue() { stop(); }
+
+void WorkerQueue::enqueue(std::function<void()> job)
+{
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        //While stopping, the old workers still run everything they find queued, including what their own tasks submit.
+        //Anyone else waits, then starts new workers.
+        if(!isWorkerThread()) cv.wait(lock, [this]() { return !stopping; });
+        jobs.push_back(job);
+        if(workers.empty() && !stopping) {
+            int num = resolveNumWorkers();
+            for(int i = 0; i<num; i++) workers.push_back(std::thread(&WorkerQueue::run, this));
+            if(!stopRegistered && stopAtExit!=nullptr) {
+                std::atexit(stopAtExit);
+                stopRegistered = true;
+            }
+        }
+    }
+    //Wake all: drain() and stop() callers share the condition variable with the workers
+    cv.notify_all();
+}
+
+void WorkerQueue::drain()
+{
+    if(isWorkerThread()) return;
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this]() { return jobs.empty() && numRunning==0; });
+}
+
+void WorkerQueue::stop()
+{
+    if(isWorkerThread()) return;
+    std::vector<std::thread> toJoin;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(workers.empty() || stopping) return;
+        stopping = true;
+        toJoin.swap(workers);
+    }
+    cv.notify_all();
+    for(size_t i = 0; i<toJoin.size(); i++) toJoin[i].join();
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = false;
+    }
+    cv.notify_all();    //Wake up submitters waiting for the stop to finish
+}
+
+size_t WorkerQueue::getNumPending()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return jobs.size()+numRunning;
+}
+
+bool WorkerQueue::isWorkerThread() {
+    return currentQueue==this;
+}
+
+void WorkerQueue::setNumWorkers(int num)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    numWorkers = std::max(0, num);
+}
+
+int WorkerQueue::getNumWorkers()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return resolveNumWorkers();
+}
+
+void WorkerQueue::run()
+{
+    currentQueue = this;
+    std::unique_lock<std::mutex> lock(mtx);
+    while(true) {
+        cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if(jobs.empty()) break;     //Only stop once everything queued has run
+
+        std::function<void()> job = jobs.front();
+        jobs.pop_front();
+        numRunning++;
+        lock.unlock();
+        job();
+        lock.lock();
+        numRunning--;
+        cv.notify_all();
+    }
+}
+
+int WorkerQueue::resolveNumWorkers() {
+    return numWorkers>0 ? numWorkers : std::max(1u, std::thread::hardware_concurrency());
+}
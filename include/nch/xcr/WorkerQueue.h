@@ -0,0 +1,57 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nch { class WorkerQueue {
+public:
+    /// @brief A queue of tasks run by 'numWorkers' threads (0 = number of CPU cores), started on first use. Used by InputExecutor and OCRWorkerPool.
+    /// @param stopAtExit Should stop this queue, ex: the owner's static 'stop()'. Registered with std::atexit() the first time workers start,
+    /// since a still-running std::thread would call std::terminate() when destroyed at exit.
+    WorkerQueue(int numWorkers, void (*stopAtExit)());
+    ~WorkerQueue();
+
+    /// @brief Queue 'task' and return immediately. With a single worker, tasks run one at a time in submission order.
+    /// @return A future that becomes ready once 'task' has finished (holding its return value).
+    template<typename F> auto submit(F task) -> std::future<decltype(task())> {
+        typedef decltype(task()) R;
+        std::shared_ptr<std::packaged_task<R()>> pt = std::make_shared<std::packaged_task<R()>>(task);
+        std::future<R> res = pt->get_future();
+        enqueue([pt]() { (*pt)(); });
+        return res;
+    }
+    void enqueue(std::function<void()> job);
+
+    /// @brief Block until every task queued so far has finished. Does nothing on a worker thread (it would wait for itself).
+    void drain();
+    /// @brief Finish every queued task, then stop all workers. Queuing again restarts them. Does nothing on a worker thread.
+    void stop();
+    /// @return The number of tasks that are queued or running.
+    size_t getNumPending();
+    /// @return True if called from one of this queue's workers (waiting on a future from there can deadlock).
+    bool isWorkerThread();
+
+    /// @brief Set the number of worker threads (0 = number of CPU cores). Takes effect the next time the workers start.
+    void setNumWorkers(int numWorkers);
+    int getNumWorkers();
+private:
+    void run();
+    int resolveNumWorkers();
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> workers;
+    int numWorkers;
+    bool stopping = false;
+    size_t numRunning = 0;
+    void (*stopAtExit)();
+    bool stopRegistered = false;
+
+    static thread_local const WorkerQueue* currentQueue;   //The queue whose worker is the calling thread, if any
+}; }
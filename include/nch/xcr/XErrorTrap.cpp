@@ -0,0 +1,84 @@
+#include "XErrorTrap.h"
+#include <algorithm>
+
+using namespace nch;
+
+std::mutex XErrorTrap::mtx;
+std::map<Display*, XErrorTrap::DisplayState> XErrorTrap::displays;
+int (*XErrorTrap::prevHandler)(Display*, XErrorEvent*) = nullptr;
+std::once_flag XErrorTrap::installed;
+
+XErrorTrap::XErrorTrap(Display* disp)
+{
+    install();
+    trapDisp = disp;
+    XLockDisplay(disp);
+    startSerial = NextRequest(disp);
+    XUnlockDisplay(disp);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    displays[disp].traps.push_back(this);
+}
+
+XErrorTrap::~XErrorTrap()
+{
+    XSync(trapDisp, False);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    std::map<Display*, DisplayState>::iterator itr = displays.find(trapDisp);
+    if(itr==displays.end()) return;
+    std::vector<XErrorTrap*>& traps = itr->second.traps;
+    traps.erase(std::remove(traps.begin(), traps.end(), this), traps.end());
+    if(traps.empty() && !itr->second.ignored) displays.erase(itr);
+}
+
+bool XErrorTrap::failed() { return getErrorCode()!=0; }
+
+int XErrorTrap::getErrorCode()
+{
+    XSync(trapDisp, False);
+    std::lock_guard<std::mutex> lock(mtx);
+    return errorCode;
+}
+
+void XErrorTrap::ignoreDisplay(Display* disp, bool ignore)
+{
+    install();
+    std::lock_guard<std::mutex> lock(mtx);
+    if(ignore) {
+        displays[disp].ignored = true;
+        return;
+    }
+
+    std::map<Display*, DisplayState>::iterator itr = displays.find(disp);
+    if(itr==displays.end()) return;
+    itr->second.ignored = false;
+    if(itr->second.traps.empty()) displays.erase(itr);
+}
+
+void XErrorTrap::install()
+{
+    std::call_once(installed, []() { prevHandler = XSetErrorHandler(handler); });
+}
+
+int XErrorTrap::handler(Display* disp, XErrorEvent* err)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::map<Display*, DisplayState>::iterator itr = displays.find(disp);
+        if(itr!=displays.end()) {
+            //Give the error to every trap that was alive when the failing request was made
+            bool trapped = false;
+            for(size_t i = 0; i<itr->second.traps.size(); i++) {
+                XErrorTrap* trap = itr->second.traps[i];
+                if(err->serial<trap->startSerial) continue;
+                if(trap->errorCode==0) trap->errorCode = err->error_code;
+                trapped = true;
+            }
+            if(trapped || itr->second.ignored) return 0;
+        }
+    }
+
+    if(prevHandler!=nullptr) return prevHandler(disp, err);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace nch { class XErrorTrap {
+public:
+    /// Xlib has a single, process-wide error handler, and its default one exits the process. Swapping handlers back and forth from several threads
+    /// can restore them out of order, so instead one handler is installed once (on first use) and never removed: it dispatches each error by its Display*.
+    /// Errors on a display with no trap alive (and not ignored) are passed on to the handler that was installed before.
+    /// Errors are told apart by display and request serial only, not by thread: only trap on a connection that no other thread sends requests on at the same time.
+    /// @brief While alive, record X errors on 'disp' caused by requests made after construction, instead of killing the process.
+    XErrorTrap(Display* disp);
+    /// @brief Waits for every pending request (XSync()) so their errors are still trapped.
+    ~XErrorTrap();
+
+    /// @return True if a request made since construction raised an X error. Waits for every pending request (XSync()).
+    bool failed();
+    /// @return The first X error code trapped since construction (0 if none). Waits for every pending request (XSync()).
+    int getErrorCode();
+
+    /// @brief Ignore (ignore=true) or stop ignoring (ignore=false) every X error on 'disp', ex: for a connection that watches windows which can vanish at any moment.
+    static void ignoreDisplay(Display* disp, bool ignore);
+private:
+    struct DisplayState {
+        bool ignored = false;
+        std::vector<XErrorTrap*> traps;
+    };
+
+    static void install();
+    static int handler(Display* disp, XErrorEvent* err);
+
+    Display* trapDisp;
+    unsigned long startSerial;
+    int errorCode = 0;      //Guarded by 'mtx'
+
+    static std::mutex mtx;
+    static std::map<Display*, DisplayState> displays;
+    static int (*prevHandler)(Display*, XErrorEvent*);
+    static std::once_flag installed;
+}; }
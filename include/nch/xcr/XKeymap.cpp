@@ -0,0 +1,218 @@
+#include "XKeymap.h"
+#include <X11/XKBlib.h>
+#include <chrono>
+#include <nch/cpp-utils/log.h>
+#include <thread>
+
+using namespace nch;
+
+static_assert(XKeymap::unicodeToKeysym('a')==XK_a, "ASCII keysyms match their codepoints");
+static_assert(XKeymap::unicodeToKeysym('\n')==XK_Return, "newline is typed with Return");
+static_assert(XKeymap::unicodeToKeysym(0x20ac)==0x10020ac, "non Latin-1 keysyms are Unicode keysyms");
+
+std::mutex XKeymap::mtx;
+Display* XKeymap::cacheDisp = nullptr;
+std::unordered_map<KeySym, XKeymap::KeyEntry> XKeymap::entries;
+KeyCode XKeymap::scratchCode = 0;
+bool XKeymap::scratchMapped = false;
+KeySym XKeymap::scratchSym = NoSymbol;
+int64_t XKeymap::scratchRestoreNS = 0;
+int XKeymap::xkbEventBase = -1;
+
+static int64_t steadyNowNS() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<uint32_t> XKeymap::decodeUTF8(const std::string& text)
+{
+    std::vector<uint32_t> res;
+    res.reserve(text.size());
+    for(size_t i = 0; i<text.size(); ) {
+        uint8_t c = text[i];
+        int len = (c<0x80) ? 1 : ((c>>5)==0x6) ? 2 : ((c>>4)==0xe) ? 3 : ((c>>3)==0x1e) ? 4 : 0;
+        if(len==0 || i+len>text.size()) { i++; continue; }
+
+        uint32_t cp = (len==1) ? c : (c&(0x7f>>len));
+        bool valid = true;
+        for(int j = 1; j<len; j++) {
+            uint8_t cc = text[i+j];
+            if((cc>>6)!=0x2) { valid = false; break; }
+            cp = (cp<<6)|(cc&0x3f);
+        }
+        if(valid) { res.push_back(cp); i += len; }
+        else      { i++; }
+    }
+    return res;
+}
+
+bool XKeymap::lookup(Display* disp, KeySym sym, KeyEntry& res)
+{
+    if(disp==nullptr) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(disp!=cacheDisp) rebuild(disp);
+    else { flushScratchKeyLocked(disp, false); checkLayoutChanges(disp); }
+    if(entries.empty()) rebuild(disp);
+
+    auto itr = entries.find(sym);
+    if(itr==entries.end()) return false;
+    res = itr->second;
+    return true;
+}
+
+bool XKeymap::remapScratchKey(Display* disp, KeySym sym, KeyEntry& res)
+{
+    if(disp==nullptr) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(disp!=cacheDisp || entries.empty()) rebuild(disp);
+    if(scratchCode==0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "No unused keycode to remap");
+        return false;
+    }
+
+    if(scratchMapped && scratchSym==sym) {
+        //Still bound from a previous keystroke: cancel its restore and reuse it
+        scratchRestoreNS = 0;
+    } else {
+        //Clients may still be translating the previous keysym's events: let its delay run out before rebinding
+        flushScratchKeyLocked(disp, true);
+        KeySym syms[2] = { sym, sym };
+        XChangeKeyboardMapping(disp, scratchCode, 2, syms, 1);
+        XSync(disp, False);
+        scratchMapped = true;
+        scratchSym = sym;
+    }
+
+    res = KeyEntry();
+    res.code = scratchCode;
+    return true;
+}
+
+bool XKeymap::getScratchKey(KeySym sym, KeyEntry& res)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!scratchMapped || scratchSym!=sym) return false;
+    res = KeyEntry();
+    res.code = scratchCode;
+    return true;
+}
+
+void XKeymap::restoreScratchKey(Display* disp, int delayMS)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(!scratchMapped || disp==nullptr || disp!=cacheDisp) return;
+    if(delayMS<=0) {
+        unmapScratchKey(disp);
+    } else {
+        scratchRestoreNS = steadyNowNS()+(int64_t)delayMS*1000000LL;
+    }
+}
+
+void XKeymap::flushScratchKey(Display* disp, bool wait)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(disp==nullptr || disp!=cacheDisp) return;
+    flushScratchKeyLocked(disp, wait);
+}
+
+void XKeymap::invalidate() {
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.clear();
+}
+
+void XKeymap::rebuild(Display* disp)
+{
+    //Ask to be told about layout changes (once per display)
+    if(disp!=cacheDisp) {
+        int opcode, errBase, major = XkbMajorVersion, minor = XkbMinorVersion;
+        if(XkbQueryExtension(disp, &opcode, &xkbEventBase, &errBase, &major, &minor)) {
+            XkbSelectEvents(disp, XkbUseCoreKbd, XkbNewKeyboardNotifyMask|XkbMapNotifyMask, XkbNewKeyboardNotifyMask|XkbMapNotifyMask);
+        } else {
+            xkbEventBase = -1;
+        }
+        cacheDisp = disp;
+        scratchCode = 0;
+        scratchMapped = false;
+        scratchSym = NoSymbol;
+        scratchRestoreNS = 0;
+    }
+
+    //Scan every keycode once. Lower shift levels win, so 'a' is typed without shift even if some other key has it on level 2.
+    entries.clear();
+    int minKc, maxKc;
+    XDisplayKeycodes(disp, &minKc, &maxKc);
+    for(int level = 0; level<4; level++) {
+        for(int kc = minKc; kc<=maxKc; kc++) {
+            if(kc==scratchCode) continue;   //Only ever bound temporarily, see 'getScratchKey()'
+            KeySym sym = XkbKeycodeToKeysym(disp, kc, 0, level);
+            if(sym==NoSymbol || entries.count(sym)) continue;
+            KeyEntry e;
+            e.code = kc;
+            e.shift = (level&1)!=0;
+            e.altGr = level>=2;
+            entries[sym] = e;
+        }
+    }
+
+    //Remember a keycode that has nothing bound to it, for typing keysyms that aren't on the layout
+    if(scratchCode==0) {
+        for(int kc = maxKc; kc>=minKc && scratchCode==0; kc--) {
+            bool unused = true;
+            for(int level = 0; level<4 && unused; level++) {
+                if(XkbKeycodeToKeysym(disp, kc, 0, level)!=NoSymbol) unused = false;
+            }
+            if(unused) scratchCode = kc;
+        }
+    }
+}
+
+void XKeymap::checkLayoutChanges(Display* disp)
+{
+    //Every XChangeKeyboardMapping() (ours included) also sends a core MappingNotify: drain them so they don't pile up in Xlib's queue
+    XEvent ev;
+    bool coreChanged = false;
+    while(XCheckTypedEvent(disp, MappingNotify, &ev)) {
+        XRefreshKeyboardMapping(&ev.xmapping);
+        if(ev.xmapping.request!=MappingKeyboard) continue;
+        bool scratchOnly = scratchCode!=0 && ev.xmapping.first_keycode==scratchCode && ev.xmapping.count<=1;
+        if(!scratchOnly) coreChanged = true;
+    }
+    if(xkbEventBase<0) {
+        //Without XKB, MappingNotify is the only layout change notification
+        if(coreChanged) entries.clear();
+        return;
+    }
+
+    //Drain pending XKB events without blocking
+    while(XCheckTypedEvent(disp, xkbEventBase, &ev)) {
+        XkbEvent* xkbEv = (XkbEvent*)&ev;
+        if(xkbEv->any.xkb_type==XkbNewKeyboardNotify) {
+            entries.clear();
+        } else if(xkbEv->any.xkb_type==XkbMapNotify) {
+            XkbRefreshKeyboardMapping(&xkbEv->map);
+            //Our own scratch key remapping doesn't change anything we cached
+            bool scratchOnly = scratchCode!=0 && xkbEv->map.first_key_sym==scratchCode && xkbEv->map.num_key_syms<=1;
+            if(!scratchOnly) entries.clear();
+        }
+    }
+}
+
+void XKeymap::flushScratchKeyLocked(Display* disp, bool wait)
+{
+    if(!scratchMapped || scratchRestoreNS==0) return;
+    int64_t left = scratchRestoreNS-steadyNowNS();
+    if(left>0) {
+        if(!wait) return;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(left));
+    }
+    unmapScratchKey(disp);
+}
+
+void XKeymap::unmapScratchKey(Display* disp)
+{
+    KeySym syms[2] = { NoSymbol, NoSymbol };
+    XChangeKeyboardMapping(disp, scratchCode, 2, syms, 1);
+    XSync(disp, False);
+    scratchMapped = false;
+    scratchSym = NoSymbol;
+    scratchRestoreNS = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nch { class XKeymap {
+public:
+    /// @brief How to produce a keysym on the current layout: press 'code' while holding shift and/or AltGr (ISO_Level3_Shift).
+    struct KeyEntry { KeyCode code = 0; bool shift = false; bool altGr = false; };
+
+    /// @brief Compile-time Unicode codepoint -> X11 keysym mapping.
+    /// @brief Printable Latin-1 maps to itself, '\n'/'\t'/'\b' map to Return/Tab/BackSpace, everything else above U+00FF maps to 0x01000000+codepoint.
+    /// @return The keysym, or NoSymbol for control characters without a key.
+    static constexpr KeySym unicodeToKeysym(uint32_t cp) {
+        return  cp=='\n' || cp=='\r'            ? XK_Return :
+                cp=='\t'                        ? XK_Tab :
+                cp=='\b'                        ? XK_BackSpace :
+                (cp>=0x20 && cp<=0x7e)          ? (KeySym)cp :
+                (cp>=0xa0 && cp<=0xff)          ? (KeySym)cp :
+                (cp>=0x100 && cp<=0x10ffff)     ? (KeySym)(0x01000000|cp) :
+                NoSymbol;
+    }
+    /// @brief Decode UTF-8 text into Unicode codepoints. Invalid bytes are skipped.
+    static std::vector<uint32_t> decodeUTF8(const std::string& text);
+
+    /// @brief Find how to type 'sym' on the current keyboard layout. The whole layout is scanned once and cached;
+    /// @brief the cache is rebuilt automatically after the layout changes (XkbNewKeyboardNotify/XkbMapNotify).
+    /// @return False if no key produces 'sym' (see 'remapScratchKey()').
+    static bool lookup(Display* disp, KeySym sym, KeyEntry& res);
+    /// @brief Temporarily bind 'sym' to an unused keycode so it can be typed even though it isn't on the layout (ex: non-ASCII text).
+    /// @brief If 'sym' is still bound there (restore pending), the binding is reused. If another keysym's restore is pending, waits for it first.
+    /// @return False if the layout has no unused keycode.
+    static bool remapScratchKey(Display* disp, KeySym sym, KeyEntry& res);
+    /// @return True (and the scratch key in 'res') if 'sym' is currently bound to the scratch key by 'remapScratchKey()'.
+    static bool getScratchKey(KeySym sym, KeyEntry& res);
+    /// @brief Undo 'remapScratchKey()', 'delayMS' milliseconds from now. A delayed restore is done by the next call to this class after the delay
+    /// @brief (without blocking), or by 'flushScratchKey()'.
+    static void restoreScratchKey(Display* disp, int delayMS = 0);
+    /// @brief Do a pending delayed restore now, first waiting out its delay if 'wait' is true (otherwise only if the delay is over).
+    static void flushScratchKey(Display* disp, bool wait);
+    /// @brief Force the cache to be rebuilt on the next lookup.
+    static void invalidate();
+private:
+    static void rebuild(Display* disp);
+    static void checkLayoutChanges(Display* disp);
+    static void flushScratchKeyLocked(Display* disp, bool wait);
+    static void unmapScratchKey(Display* disp);
+
+    static std::mutex mtx;
+    static Display* cacheDisp;
+    static std::unordered_map<KeySym, KeyEntry> entries;
+    static KeyCode scratchCode;
+    static bool scratchMapped;
+    static KeySym scratchSym;           //What the scratch key is bound to (if 'scratchMapped')
+    static int64_t scratchRestoreNS;    //When to do a delayed restore (steady_clock), 0 if none is pending
+    static int xkbEventBase;
+}; }
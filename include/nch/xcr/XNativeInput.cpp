@@ -0,0 +1,229 @@
+#include "XNativeInput.h"
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <nch/cpp-utils/log.h>
+#include <nch/cpp-utils/string-utils.h>
+#include "Xcalibur.h"
+
+using namespace nch;
+
+Display* XNativeInput::ownDisp = nullptr;
+Display* XNativeInput::checkedDisp = nullptr;
+bool XNativeInput::checkedAvailable = false;
+std::mutex XNativeInput::mtx;
+
+bool XNativeInput::isAvailable()
+{
+    Display* disp = getDisplay();
+    if(disp==nullptr) return false;
+
+    //Query the XTest extension once per display
+    std::lock_guard<std::mutex> lock(mtx);
+    if(disp!=checkedDisp) {
+        int evBase, errBase, major, minor;
+        checkedAvailable = XTestQueryExtension(disp, &evBase, &errBase, &major, &minor);
+        checkedDisp = disp;
+        if(!checkedAvailable) {
+            Log::warnv(__PRETTY_FUNCTION__, "falling back to xdotool", "XTest extension is not available on this display");
+        }
+    }
+    return checkedAvailable;
+}
+
+void XNativeInput::free()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(ownDisp==nullptr) return;
+    if(checkedDisp==ownDisp) checkedDisp = nullptr;
+    XKeymap::flushScratchKey(ownDisp, true);
+    XCloseDisplay(ownDisp);
+    ownDisp = nullptr;
+}
+
+bool XNativeInput::moveMouse(int x, int y)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+    XTestFakeMotionEvent(disp, -1, x, y, CurrentTime);
+    XFlush(disp);
+    return true;
+}
+
+bool XNativeInput::mouseButton(int btn, bool down)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+    XTestFakeButtonEvent(disp, btn, down ? True : False, CurrentTime);
+    XFlush(disp);
+    return true;
+}
+
+bool XNativeInput::mouseClick(int btn)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+    XTestFakeButtonEvent(disp, btn, True, CurrentTime);
+    XTestFakeButtonEvent(disp, btn, False, CurrentTime);
+    XFlush(disp);
+    return true;
+}
+
+bool XNativeInput::keyDown(const std::string& keySeq) { return sendKeys(keySeq, true); }
+bool XNativeInput::keyUp(const std::string& keySeq) { return sendKeys(keySeq, false); }
+
+bool XNativeInput::activateWindow(int winID)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+    Window root = DefaultRootWindow(disp);
+    Window win = (Window)(unsigned int)winID;
+
+    Atom netActiveWindow = XInternAtom(disp, "_NET_ACTIVE_WINDOW", True);
+    if(netActiveWindow==None) {
+        XRaiseWindow(disp, win);
+        XSetInputFocus(disp, win, RevertToParent, CurrentTime);
+        XFlush(disp);
+        return true;
+    }
+
+    //Source indication 2 = "pager", which window managers honor without focus stealing prevention
+    XEvent ev = {};
+    ev.xclient.type = ClientMessage;
+    ev.xclient.serial = 0;
+    ev.xclient.send_event = True;
+    ev.xclient.window = win;
+    ev.xclient.message_type = netActiveWindow;
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = 2;
+    ev.xclient.data.l[1] = CurrentTime;
+    ev.xclient.data.l[2] = 0;
+    XSendEvent(disp, root, False, SubstructureRedirectMask|SubstructureNotifyMask, &ev);
+    XFlush(disp);
+    return true;
+}
+
+Display* XNativeInput::getDisplay()
+{
+    Display* xcrDisp = Xcalibur::getOpenedDisplay();
+    if(xcrDisp!=nullptr) return xcrDisp;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if(ownDisp==nullptr) {
+        //The display is shared by the input scheduler, input executor and mouse trajectory threads: Xlib must be made thread-safe before its first use
+        static std::once_flag threadsInitted;
+        std::call_once(threadsInitted, []() { XInitThreads(); });
+        ownDisp = XOpenDisplay(NULL);
+        if(ownDisp==nullptr) {
+            Log::error(__PRETTY_FUNCTION__, "Failed to open display...");
+        }
+    }
+    return ownDisp;
+}
+
+bool XNativeInput::keysymDown(KeySym sym)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+
+    XKeymap::KeyEntry key;
+    if(!XKeymap::lookup(disp, sym, key) && !XKeymap::remapScratchKey(disp, sym, key)) return false;
+    bool res = sendKeyEntry(disp, key, true);
+    XFlush(disp);
+    return res;
+}
+
+bool XNativeInput::keysymUp(KeySym sym)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+
+    //Check the scratch key first: a layout change between down and up may have rebuilt the cache, and the keysym is only bound there temporarily
+    XKeymap::KeyEntry key;
+    bool remapped = XKeymap::getScratchKey(sym, key);
+    if(!remapped && !XKeymap::lookup(disp, sym, key)) return false;
+    bool res = sendKeyEntry(disp, key, false);
+    XFlush(disp);
+    if(remapped) {
+        //Clients translate the key events with the keymap they fetch after MappingNotify: give them time to do so before the scratch key is unbound again.
+        //The restore is deferred (not slept on here) so the caller's timing isn't skewed.
+        XKeymap::restoreScratchKey(disp, scratchRestoreDelayMS);
+    }
+    return res;
+}
+
+bool XNativeInput::parseKeySequence(const std::string& keySeq, std::vector<XKeymap::KeyEntry>& res)
+{
+    Display* disp = getDisplay();
+    res.clear();
+
+    std::vector<std::string> names = StringUtils::split(keySeq, '+');
+    for(size_t i = 0; i<names.size(); i++) {
+        //xdotool-style modifier aliases
+        std::string name = names[i];
+        if(name=="ctrl")  name = "Control_L";
+        if(name=="shift") name = "Shift_L";
+        if(name=="alt")   name = "Alt_L";
+        if(name=="super") name = "Super_L";
+        if(name=="meta")  name = "Meta_L";
+
+        KeySym sym = XStringToKeysym(name.c_str());
+        if(sym==NoSymbol) return false;
+        //The keymap cache knows whether shift/AltGr is needed (ex: 'A', '!')
+        XKeymap::KeyEntry k;
+        if(!XKeymap::lookup(disp, sym, k)) return false;
+        res.push_back(k);
+    }
+    return !res.empty();
+}
+
+bool XNativeInput::sendKeys(const std::string& keySeq, bool down)
+{
+    if(!isAvailable()) return false;
+    Display* disp = getDisplay();
+
+    std::vector<XKeymap::KeyEntry> keys;
+    if(!parseKeySequence(keySeq, keys)) return false;
+
+    //All or nothing: callers fall back to xdotool on failure, which must not press keys a second time
+    for(size_t i = 0; i<keys.size(); i++) {
+        if(!canSendKeyEntry(disp, keys[i])) return false;
+    }
+    if(down) {
+        for(size_t i = 0; i<keys.size(); i++) sendKeyEntry(disp, keys[i], true);
+    } else {
+        for(size_t i = keys.size(); i-->0; ) sendKeyEntry(disp, keys[i], false);
+    }
+    XFlush(disp);
+    return true;
+}
+
+bool XNativeInput::canSendKeyEntry(Display* disp, const XKeymap::KeyEntry& key)
+{
+    KeyCode shiftCode = XKeysymToKeycode(disp, XK_Shift_L);
+    KeyCode altGrCode = XKeysymToKeycode(disp, XK_ISO_Level3_Shift);
+    //Keycode 0 doesn't exist (XTest would raise BadValue)
+    if((key.shift && shiftCode==0) || (key.altGr && altGrCode==0) || key.code==0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "No keycode for %s on this layout", key.code==0 ? "the key" : (key.altGr && altGrCode==0 ? "AltGr (ISO_Level3_Shift)" : "Shift_L"));
+        return false;
+    }
+    return true;
+}
+
+bool XNativeInput::sendKeyEntry(Display* disp, const XKeymap::KeyEntry& key, bool down)
+{
+    if(!canSendKeyEntry(disp, key)) return false;
+    KeyCode shiftCode = XKeysymToKeycode(disp, XK_Shift_L);
+    KeyCode altGrCode = XKeysymToKeycode(disp, XK_ISO_Level3_Shift);
+
+    //Modifiers go down before the key and come up after it
+    if(down) {
+        if(key.shift) XTestFakeKeyEvent(disp, shiftCode, True, CurrentTime);
+        if(key.altGr) XTestFakeKeyEvent(disp, altGrCode, True, CurrentTime);
+        XTestFakeKeyEvent(disp, key.code, True, CurrentTime);
+    } else {
+        XTestFakeKeyEvent(disp, key.code, False, CurrentTime);
+        if(key.altGr) XTestFakeKeyEvent(disp, altGrCode, False, CurrentTime);
+        if(key.shift) XTestFakeKeyEvent(disp, shiftCode, False, CurrentTime);
+    }
+    return true;
+}
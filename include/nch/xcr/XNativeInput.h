@@ -0,0 +1,53 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "XKeymap.h"
+
+namespace nch { class XNativeInput {
+public:
+    /// @brief Check whether native input is usable: an X11 display is reachable and it supports the XTest extension.
+    /// @brief Uses Xcalibur's display if Xcalibur is initialized, otherwise opens (and keeps) a display of its own.
+    /// @return True if the other functions of this class can be used, false if callers should fall back to xdotool.
+    static bool isAvailable();
+    /// @brief Close the display opened by this class (if any). Does nothing to Xcalibur's display.
+    static void free();
+
+    /// @brief Move the mouse cursor to the absolute position (x, y).
+    static bool moveMouse(int x, int y);
+    /// @brief Press (down=true) or release (down=false) mouse button 'btn' (1=left, 2=middle, 3=right, 4/5=scroll).
+    static bool mouseButton(int btn, bool down);
+    /// @brief Press and release mouse button 'btn' in quick succession.
+    static bool mouseClick(int btn);
+    /// @brief Press or release every key of an xdotool-style key sequence (ex: "a", "Return", "ctrl+v", "shift+Tab").
+    /// @brief Keys are pressed in order and released in reverse order. Shift is added automatically for keysyms that need it (ex: "A", "exclam").
+    /// @return False if any key in 'keySeq' is unknown to the current keyboard mapping or can't be sent (nothing is sent in that case, so falling back to xdotool is safe).
+    static bool keyDown(const std::string& keySeq);
+    static bool keyUp(const std::string& keySeq);
+    /// @brief Press or release the key producing 'sym' (see XKeymap::unicodeToKeysym()), with shift/AltGr as the layout requires.
+    /// @brief Keysyms that aren't on the layout are typed by temporarily binding them to an unused keycode, which is restored shortly after release.
+    static bool keysymDown(KeySym sym);
+    static bool keysymUp(KeySym sym);
+    /// @brief Ask the window manager to activate (raise + focus) the window with ID 'winID' using a _NET_ACTIVE_WINDOW message.
+    /// @brief Falls back to XRaiseWindow() + XSetInputFocus() if the window manager isn't EWMH compliant.
+    static bool activateWindow(int winID);
+
+    /// @brief Xcalibur's display if it is initialized. Otherwise a display of this class' own, opened on first use (after XInitThreads()). Thread-safe.
+    /// @return The display that input is sent to, or nullptr if there is none.
+    static Display* getDisplay();
+private:
+    static bool parseKeySequence(const std::string& keySeq, std::vector<XKeymap::KeyEntry>& res);
+    /// @return False if the layout has no keycode for the key or a modifier it needs (ex: no AltGr).
+    static bool canSendKeyEntry(Display* disp, const XKeymap::KeyEntry& key);
+    /// @return False (sending nothing) if 'canSendKeyEntry()' fails.
+    static bool sendKeyEntry(Display* disp, const XKeymap::KeyEntry& key, bool down);
+    static bool sendKeys(const std::string& keySeq, bool down);
+
+    static const int scratchRestoreDelayMS = 20;  //How long a remapped scratch key stays bound after its key-up
+
+    static Display* ownDisp;
+    static Display* checkedDisp;
+    static bool checkedAvailable;
+    static std::mutex mtx;      //Guards the 3 above
+}; }
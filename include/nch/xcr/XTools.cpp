@@ -5,17 +5,32 @@
 #include <nch/sdl-utils/texture-utils.h>
 #include <SDL2/SDL_image.h>
 #include <sys/shm.h>
+#include "InputExecutor.h"
+#include "InputScheduler.h"
 #include "MiscTools.h"
+#include "MouseTrajectory.h"
+#include "PointerSampler.h"
 #include "Shell.h"
+#include "WaitFor.h"
+#include "XNativeInput.h"
+#include "XWindowBatch.h"
+#include "XWindowControl.h"
+#include "XWindowCache.h"
+#include "XWindowQuery.h"
 
 using namespace nch;
 
 Vec2i XTools::getMouseXY()
 {
     Vec2i res;
+    //Single XQueryPointer round-trip
+    if(PointerSampler::queryPointer(res)) return res;
+
+    //xdotool fallback (x and y both come from the same sample)
     try {
-        res.x = std::stoi( StringUtils::split(Shell::exec("xdotool getmouselocation"), ' ').at(0).substr(2) );
-        res.y = std::stoi( StringUtils::split(Shell::exec("xdotool getmouselocation"), ' ').at(1).substr(2) );
+        auto split = StringUtils::split(Shell::exec("xdotool getmouselocation"), ' ');
+        res.x = std::stoi( split.at(0).substr(2) );
+        res.y = std::stoi( split.at(1).substr(2) );
     } catch(...) { res = {-1, -1}; }
     return res;
 }
@@ -26,6 +41,16 @@ Rect XTools::getWindowRect(int windowID)
     Rect res;
     res.r.x = -1; res.r.y = -1;
     res.r.w = -1; res.r.h = -1;
+
+    //Answer from memory if the window cache is running, otherwise do a native query (no 'xwininfo' process)
+    CachedWindow cw;
+    if(XWindowCache::isRunning() && XWindowCache::getWindow((Window)(unsigned int)windowID, cw)) {
+        return cw.rect;
+    }
+    if(XNativeInput::getDisplay()!=nullptr) {
+        XWindowQuery::getWindowRect((Window)(unsigned int)windowID, res);
+        return res;
+    }
     
     std::stringstream cmd;
     cmd << "xwininfo -id " << windowID;
@@ -49,11 +74,39 @@ Rect XTools::getWindowRect(int windowID)
     return res;
 }
 
+std::vector<Rect> XTools::getWindowRects(const std::vector<int>& windowIDs)
+{
+    std::vector<Window> wins;
+    for(int i = 0; i<windowIDs.size(); i++) wins.push_back((Window)(unsigned int)windowIDs[i]);
+
+    //One pipelined xcb batch (a single round-trip) for all windows
+    std::vector<WindowGeometry> geos = XWindowBatch::query(wins);
+    std::vector<Rect> res;
+    for(int i = 0; i<geos.size(); i++) {
+        if(geos[i].noConnection) {
+            //No (working) xcb connection: fall back to one query per window
+            res.push_back(getWindowRect(windowIDs[i]));
+        } else {
+            res.push_back(geos[i].ok ? geos[i].rect : Rect(-1, -1, -1, -1));
+        }
+    }
+    return res;
+}
+
 std::vector<int> XTools::findWindowIDsByTitle(std::string substr)
 {
     std::vector<int> res;
     if(!StringUtils::validateSafeString(substr)) return res;
 
+    if(XWindowCache::isRunning()) {
+        for(Window w : XWindowCache::findWindowsByTitle(substr)) res.push_back((int)w);
+        return res;
+    }
+    if(XNativeInput::getDisplay()!=nullptr) {
+        for(Window w : XWindowQuery::findWindowsByTitle(substr)) res.push_back((int)w);
+        return res;
+    }
+
     auto execRes = StringUtils::split(Shell::exec("xdotool search --onlyvisible --name '"+substr+"'"), '\n');
     for(std::string line : execRes) { try { res.push_back(std::stoi(line)); } catch(...) {} }
     return res;
@@ -64,6 +117,15 @@ std::vector<int> XTools::findWindowIDsByClassName(std::string substr)
     std::vector<int> res;
     if(!StringUtils::validateSpaceless(substr)) return res;
 
+    if(XWindowCache::isRunning()) {
+        for(Window w : XWindowCache::findWindowsByClassName(substr)) res.push_back((int)w);
+        return res;
+    }
+    if(XNativeInput::getDisplay()!=nullptr) {
+        for(Window w : XWindowQuery::findWindowsByClassName(substr)) res.push_back((int)w);
+        return res;
+    }
+
     auto execRes = StringUtils::split(Shell::exec("xdotool search --onlyvisible --classname '"+substr+"'"), '\n');
     for(std::string line : execRes) { try { res.push_back(std::stoi(line)); } catch(...) {} }
     return res;
@@ -82,6 +144,15 @@ int XTools::getWindowIDByClassName(std::string regex)
 
 int XTools::getActiveWindowID()
 {
+    if(XWindowCache::isRunning()) {
+        Window active = XWindowCache::getActiveWindow();
+        if(active!=None) return (int)active;
+    }
+    if(XNativeInput::getDisplay()!=nullptr) {
+        Window active = XWindowQuery::getActiveWindow();
+        if(active!=None) return (int)active;
+    }
+
     try { return std::stoi(Shell::exec("xdotool getactivewindow")); } catch(...) {}
     Log::warnv(__PRETTY_FUNCTION__, "returning -1", "Failed to run \"xdotool getactivewindow\"");
     return -1;
@@ -105,7 +176,7 @@ std::string XTools::charToKeyCode(char c)
         case '%': return "percent";
         case '^': return "asciicircum";
         case '&': return "ampersand";
-        case '*': return "exclam";
+        case '*': return "asterisk";
         case '(': return "parenleft";
         case ')': return "parenright";
         case '-': return "minus";
@@ -146,25 +217,21 @@ void XTools::naturallyTypeString(std::string toType)
     uint64_t sum = 0;
     for(int i = 0; i<toType.size(); i++) sum += toType[i];
 
-    /* Execute the typing operation */
-    for(int i = 0; i<toType.size(); i++) {
-        //Get char and its keycode
-        char c = toType[i];
-        std::string kc = charToKeyCode(c);
-        if(kc=="") continue;
-        //RNG
-        std::srand(sum+c);
-        naturalKeystroke(kc);
-    }
+    /* Execute the typing operation (all delays are planned up front and run against absolute deadlines) */
+    InputScheduler::run(InputScript::typing(toType, sum));
 }
 
 void XTools::naturalKeystroke(std::string keycode)
 {
     int keyDownMS = 15+(std::rand()%15);
     int keyUpMS = 35+(std::rand()%55);
-    //Randomly hold down key and release
-    Shell::exec(std::string("xdotool keydown "+keycode));   Timer::sleep(keyDownMS);   //Key down for some amount of time
-    Shell::exec(std::string("xdotool keyup "+keycode));     Timer::sleep(keyUpMS);     //Key up for some amount of time, then continue to next
+    //Randomly hold down key and release (natively if possible, with xdotool otherwise). Native calls send nothing when they fail.
+    bool native = XNativeInput::keyDown(keycode);
+    if(!native) Shell::exec(std::string("xdotool keydown "+keycode));
+    Timer::sleep(keyDownMS);    //Key down for some amount of time
+    //Release the same way the keys were pressed
+    if(!native || !XNativeInput::keyUp(keycode))    Shell::exec(std::string("xdotool keyup "+keycode));
+    Timer::sleep(keyUpMS);      //Key up for some amount of time, then continue to next
 }
 
 void XTools::naturalKeystrokes(std::vector<std::string> keycodeSet)
@@ -180,14 +247,29 @@ void XTools::setMouseXY(const Vec2i& pos)
         Log::warnv(__PRETTY_FUNCTION__, "doing nothing", "Mouse position out of bounds");
         return;
     }
+    if(XNativeInput::moveMouse(pos.x, pos.y)) return;
 
     std::stringstream cmd;
     cmd << "xdotool mousemove " << pos.x << " " << pos.y;
     Shell::exec(cmd.str());
 }
 
+void XTools::naturalMoveMouse(const Vec2i& pos)
+{
+    if(pos.x<0 || pos.y<0) {
+        Log::warnv(__PRETTY_FUNCTION__, "doing nothing", "Mouse position out of bounds");
+        return;
+    }
+
+    TrajectoryOptions opts;
+    opts.seed = std::rand();
+    MouseTrajectory::moveTo(pos, opts);
+}
+
 void XTools::mouseClick(int btn)
 {
+    if(XNativeInput::mouseClick(btn)) return;
+
     std::stringstream cmd;
     cmd << "xdotool mousedown " << btn << " && xdotool mouseup " << btn;
     Shell::exec(cmd.str());
@@ -195,6 +277,8 @@ void XTools::mouseClick(int btn)
 
 void XTools::activateWindow(int winID)
 {
+    if(XNativeInput::activateWindow(winID)) return;
+
     std::stringstream cmd;
     cmd << "xdotool windowactivate " << winID;
     Shell::exec(cmd.str());
@@ -202,6 +286,15 @@ void XTools::activateWindow(int winID)
 
 void XTools::shrinkWindowTopLeft(int winID)
 {
+    Window win = (Window)(unsigned int)winID;
+    if(XNativeInput::getDisplay()!=nullptr) {
+        //Window managers ignore resize requests for maximized windows
+        if(XWindowControl::hasState(win, XWindowControl::STATE_MAXIMIZED)) XWindowControl::maximize(win, false, 250);
+        XWindowControl::moveResize(win, Rect(0, 0, 100, 100), 250);
+        XWindowControl::activate(win, 250);
+        return;
+    }
+
     std::stringstream cmd;
     cmd << "xdotool windowmove " << winID << " 0 0";     Shell::exec(cmd.str()); cmd.str("");
     cmd << "xdotool windowsize " << winID << " 100 100"; Shell::exec(cmd.str()); cmd.str("");
@@ -211,17 +304,61 @@ void XTools::shrinkWindowTopLeft(int winID)
 
 void XTools::maximizeWindow(int winID, Vec2i maximizeButtonPos)
 {
+    //A confirmation timeout still means the request reached the window manager: only click when it can't be asked at all
+    if(XWindowControl::isSupported("_NET_WM_STATE")) {
+        XWindowControl::maximize((Window)(unsigned int)winID, true);
+        return;
+    }
+
+    //Window manager without _NET_WM_STATE: click its maximize button
+    if(maximizeButtonPos.x<0 || maximizeButtonPos.y<0) {
+        Log::warnv(__PRETTY_FUNCTION__, "doing nothing", "No _NET_WM_STATE support and no maximize button position was given");
+        return;
+    }
     shrinkWindowTopLeft(winID);
+    Rect before = getWindowRect(winID);
     XTools::setMouseXY(maximizeButtonPos);
     XTools::mouseClick(1);
-    Timer::sleep(100);
+    WaitFor::windowResized(winID, before, 100);
 }
 
 void XTools::setWindowTitle(int winID, std::string newWinTitle)
 {
+    if(XWindowControl::setTitle((Window)(unsigned int)winID, newWinTitle)) return;
     if(!StringUtils::validateInjectionless(newWinTitle)) return;
 
     std::stringstream cmd;
     cmd << "xdotool set_window --name \"" << newWinTitle << "\" " << winID;
     Shell::exec(cmd.str());
+}
+
+std::future<void> XTools::naturallyTypeStringAsync(std::string toType) {
+    return InputExecutor::submit([toType]() { naturallyTypeString(toType); });
+}
+std::future<void> XTools::naturalKeystrokeAsync(std::string keycode) {
+    return InputExecutor::submit([keycode]() { naturalKeystroke(keycode); });
+}
+std::future<void> XTools::naturalKeystrokesAsync(std::vector<std::string> keycodeSet) {
+    return InputExecutor::submit([keycodeSet]() { naturalKeystrokes(keycodeSet); });
+}
+std::future<void> XTools::setMouseXYAsync(const Vec2i& xy) {
+    return InputExecutor::submit([xy]() { setMouseXY(xy); });
+}
+std::future<void> XTools::naturalMoveMouseAsync(const Vec2i& xy) {
+    return InputExecutor::submit([xy]() { naturalMoveMouse(xy); });
+}
+std::future<void> XTools::mouseClickAsync(int btn) {
+    return InputExecutor::submit([btn]() { mouseClick(btn); });
+}
+std::future<void> XTools::activateWindowAsync(int winID) {
+    return InputExecutor::submit([winID]() { activateWindow(winID); });
+}
+std::future<void> XTools::shrinkWindowTopLeftAsync(int winID) {
+    return InputExecutor::submit([winID]() { shrinkWindowTopLeft(winID); });
+}
+std::future<void> XTools::maximizeWindowAsync(int winID, Vec2i maximizeButtonPos) {
+    return InputExecutor::submit([winID, maximizeButtonPos]() { maximizeWindow(winID, maximizeButtonPos); });
+}
+std::future<void> XTools::setWindowTitleAsync(int winID, std::string newWinTitle) {
+    return InputExecutor::submit([winID, newWinTitle]() { setWindowTitle(winID, newWinTitle); });
 }
\ No newline at end of file
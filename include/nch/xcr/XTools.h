@@ -4,6 +4,7 @@
 #include <X11/extensions/XShm.h>
 /**/
 #include <SDL2/SDL.h>
+#include <future>
 #include <string>
 #include <vector>
 #include "nch/cpp-utils/color.h"
@@ -13,13 +14,19 @@
 namespace nch { class XTools {
 public:
     /* Getters */
-    /// @brief Get the absolute (x, y) position of the mouse cursor.
+    /// Window getters answer from XWindowCache when it is running (XWindowCache::start()), query X11 directly otherwise, and only use xdotool/xwininfo without a display.
+    /// @brief Get the absolute (x, y) position of the mouse cursor (one XQueryPointer round-trip).
+    /// @brief For high-rate polling, use PointerSampler::start() + PointerSampler::getLatest() instead, which costs no X round-trip at all.
     /// @return The current position of the mouse, as a 2D vector (x, y).
     static nch::Vec2i getMouseXY();
     /// @brief Get an nch::Rect object matching up with the position and dimensions of the window with ID 'windowID'.
     /// @param xWindowID The ID of the window.
     /// @return A rectangle representing the position+dimensions of the window.
     static nch::Rect getWindowRect(int xWindowID);
+    /// @brief Same as 'getWindowRect()' for many windows at once, with a single pipelined X round-trip (see XWindowBatch).
+    /// @param xWindowIDs The IDs of the windows.
+    /// @return One rectangle per window, in the same order. Windows that couldn't be queried (ex: destroyed) get Rect(-1, -1, -1, -1).
+    static std::vector<nch::Rect> getWindowRects(const std::vector<int>& xWindowIDs);
     /// @brief Finds all visible X11 windows whose window title/classname strings match with the provided 'substr'.
     /// @param substr The substring to match against the X11 window titles/classes.
     /// @return A list of ints corresponding to the IDs of the windows found.
@@ -31,7 +38,7 @@ public:
     /// @brief Try to return the ID of the current active window. Upon failure, return -1.
     /// @return ID of the current active window.
     static int getActiveWindowID();
-    /// @brief Given a character, return the xdotool key code associated with typing that character. Returns "" and a warning if an unknown char is inputted.
+    /// @brief Given a character, return the xdotool key code associated with typing that character (for typing keysyms directly, see XKeymap::unicodeToKeysym()). Returns "" and a warning if an unknown char is inputted.
     /// @brief Supported characters: any char in " abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ`~1!2@3#4$5%6^7&8*9(0)-_=+/[]\\|;:'\",<.>?\n\t"
     /// @param c The character to get the key code from.
     /// @return The xdotool key code (a string) associated with 'c'.
@@ -40,23 +47,44 @@ public:
     /* Mutators */
     /// @brief Simulate "natural typing" (as if by a human) of a string of characters using xdotool.
     /// @brief There are small amounts of random delay in between keystrokes (may help with Cloudflare/bot detection).
-    /// @brief See charToXKeyCode() for a list of supported characters.
+    /// @brief 'toType' is UTF-8: any character can be typed, even if it isn't on the keyboard layout (see XKeymap). Use InputScript::typing() + InputScheduler directly for custom delay distributions or timing reports.
     /// @param toType The string to type using xdotool keyboard strokes, as if in a textbox.
     static void naturallyTypeString(std::string toType);
     /// @brief Simulate a "natural keystroke" (as if by a human).
     /// @brief There is a random, small delay after keydown and keyup.
+    /// @brief Keys are sent through XTest (see XNativeInput) when available, falling back to xdotool otherwise. This applies to all mutators below.
     /// @param keycode The xdotool keycode (or multiple, such as "ctrl+v") to use for the keystroke.
     static void naturalKeystroke(std::string keycode);
     static void naturalKeystrokes(std::vector<std::string> keycodeSet);
     /// @brief Set the absolute (x, y) position of the mouse cursor.
     /// @param pos A 2D vector representing the new position the mouse cursor should be at.
     static void setMouseXY(const nch::Vec2i& xy);
+    /// @brief Move the mouse cursor to (x, y) along a smooth, humanized path instead of teleporting it (see MouseTrajectory). Blocks until done.
+    static void naturalMoveMouse(const nch::Vec2i& xy);
     /// @brief Do a mouse press and a mouse release in quick succession.
     /// @param btn The mouse button to press and release
     static void mouseClick(int btn = 1);
     static void activateWindow(int winID);
+    /// @brief Unmaximize the window, move+resize it to (0, 0, 100, 100) and activate it. Returns as soon as the window manager confirms each step (see XWindowControl).
     static void shrinkWindowTopLeft(int winID);
-    static void maximizeWindow(int winID, nch::Vec2i maximizeButtonPos);
+    /// @brief Maximize the window through _NET_WM_STATE. Only if the window manager doesn't support that, shrink the window and click 'maximizeButtonPos' instead.
+    static void maximizeWindow(int winID, nch::Vec2i maximizeButtonPos = nch::Vec2i(-1, -1));
+    /// @brief Set the window's title (_NET_WM_NAME and WM_NAME).
     static void setWindowTitle(int winID, std::string newWinTitle);
+
+    /* Asynchronous mutators */
+    /// @brief Non-blocking versions of the mutators above: the work is queued on the input thread (see InputExecutor) and the call returns immediately.
+    /// @brief Queued input runs in submission order, so the caller can keep capturing/processing the screen while it executes.
+    /// @return A future that becomes ready once the input has been sent (and any delays have elapsed).
+    static std::future<void> naturallyTypeStringAsync(std::string toType);
+    static std::future<void> naturalKeystrokeAsync(std::string keycode);
+    static std::future<void> naturalKeystrokesAsync(std::vector<std::string> keycodeSet);
+    static std::future<void> setMouseXYAsync(const nch::Vec2i& xy);
+    static std::future<void> naturalMoveMouseAsync(const nch::Vec2i& xy);
+    static std::future<void> mouseClickAsync(int btn = 1);
+    static std::future<void> activateWindowAsync(int winID);
+    static std::future<void> shrinkWindowTopLeftAsync(int winID);
+    static std::future<void> maximizeWindowAsync(int winID, nch::Vec2i maximizeButtonPos = nch::Vec2i(-1, -1));
+    static std::future<void> setWindowTitleAsync(int winID, std::string newWinTitle);
 private:
 }; }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "XWindowBatch.h"
+#include <nch/cpp-utils/log.h>
+#include <stdlib.h>
+
+using namespace nch;
+
+xcb_connection_t* XWindowBatch::conn = nullptr;
+xcb_window_t XWindowBatch::root = XCB_NONE;
+xcb_atom_t XWindowBatch::atomNetWmName = XCB_NONE;
+xcb_atom_t XWindowBatch::atomUtf8String = XCB_NONE;
+
+std::vector<WindowGeometry> XWindowBatch::query(const std::vector<Window>& wins, bool withViewable, bool withTitles)
+{
+    std::vector<WindowGeometry> res(wins.size());
+    for(size_t i = 0; i<wins.size(); i++) res[i].id = wins[i];
+    if(!ensureConnection()) {
+        for(size_t i = 0; i<res.size(); i++) { res[i].errorCode = -1; res[i].noConnection = true; }
+        return res;
+    }
+
+    /* Send every request before reading any reply */
+    size_t n = wins.size();
+    std::vector<xcb_get_geometry_cookie_t> geoCookies(n);
+    std::vector<xcb_translate_coordinates_cookie_t> posCookies(n);
+    std::vector<xcb_get_window_attributes_cookie_t> attrCookies(withViewable ? n : 0);
+    std::vector<xcb_get_property_cookie_t> netNameCookies(withTitles ? n : 0), nameCookies(withTitles ? n : 0);
+    for(size_t i = 0; i<n; i++) {
+        xcb_window_t win = (xcb_window_t)wins[i];
+        geoCookies[i] = xcb_get_geometry(conn, win);
+        posCookies[i] = xcb_translate_coordinates(conn, win, root, 0, 0);
+        if(withViewable) attrCookies[i] = xcb_get_window_attributes(conn, win);
+        if(withTitles) {
+            netNameCookies[i] = xcb_get_property(conn, 0, win, atomNetWmName, atomUtf8String, 0, 1024);
+            nameCookies[i] = xcb_get_property(conn, 0, win, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 1024);
+        }
+    }
+    xcb_flush(conn);
+
+    /* Collect the replies. Errors are returned per request, so a vanished window only fails its own entry. */
+    for(size_t i = 0; i<n; i++) {
+        WindowGeometry& wg = res[i];
+        xcb_generic_error_t* err = nullptr;
+
+        xcb_get_geometry_reply_t* geo = xcb_get_geometry_reply(conn, geoCookies[i], &err);
+        if(err!=nullptr && wg.errorCode==0) wg.errorCode = err->error_code;
+        ::free(err); err = nullptr;
+        xcb_translate_coordinates_reply_t* pos = xcb_translate_coordinates_reply(conn, posCookies[i], &err);
+        if(err!=nullptr && wg.errorCode==0) wg.errorCode = err->error_code;
+        ::free(err); err = nullptr;
+        if(geo!=nullptr && pos!=nullptr) {
+            wg.rect = Rect(pos->dst_x, pos->dst_y, geo->width, geo->height);
+            wg.ok = true;
+        }
+        ::free(geo);
+        ::free(pos);
+
+        if(withViewable) {
+            xcb_get_window_attributes_reply_t* attrs = xcb_get_window_attributes_reply(conn, attrCookies[i], &err);
+            if(err!=nullptr && wg.errorCode==0) wg.errorCode = err->error_code;
+            ::free(err); err = nullptr;
+            if(attrs!=nullptr) wg.viewable = attrs->map_state==XCB_MAP_STATE_VIEWABLE;
+            else wg.ok = false;
+            ::free(attrs);
+        }
+        if(withTitles) {
+            xcb_get_property_reply_t* netName = xcb_get_property_reply(conn, netNameCookies[i], &err);
+            ::free(err); err = nullptr;
+            xcb_get_property_reply_t* name = xcb_get_property_reply(conn, nameCookies[i], &err);
+            ::free(err); err = nullptr;
+            wg.title = getReplyString(netName);
+            if(wg.title=="") wg.title = getReplyString(name);
+            ::free(netName);
+            ::free(name);
+        }
+        if(!wg.ok && wg.errorCode==0) {
+            wg.errorCode = -1;
+            //Replies without an X error are missing when the connection broke
+            wg.noConnection = xcb_connection_has_error(conn)!=0;
+        }
+    }
+
+    //A broken connection is reopened on the next call
+    if(xcb_connection_has_error(conn)) {
+        Log::warnv(__PRETTY_FUNCTION__, "reconnecting next time", "xcb connection has an error");
+        free();
+    }
+    return res;
+}
+
+void XWindowBatch::free()
+{
+    if(conn==nullptr) return;
+    xcb_disconnect(conn);
+    conn = nullptr;
+    root = XCB_NONE;
+}
+
+bool XWindowBatch::ensureConnection()
+{
+    if(conn!=nullptr) return true;
+
+    int screenNum = 0;
+    conn = xcb_connect(NULL, &screenNum);
+    if(xcb_connection_has_error(conn)) {
+        Log::error(__PRETTY_FUNCTION__, "Failed to open display...");
+        xcb_disconnect(conn);
+        conn = nullptr;
+        return false;
+    }
+
+    //Find the root window of the default screen
+    xcb_screen_iterator_t itr = xcb_setup_roots_iterator(xcb_get_setup(conn));
+    for(int i = 0; i<screenNum && itr.rem>0; i++) xcb_screen_next(&itr);
+    root = itr.data->root;
+
+    //Intern both atoms in a single round-trip
+    xcb_intern_atom_cookie_t netWmNameCookie = xcb_intern_atom(conn, 0, 12, "_NET_WM_NAME");
+    xcb_intern_atom_cookie_t utf8StringCookie = xcb_intern_atom(conn, 0, 11, "UTF8_STRING");
+    xcb_intern_atom_reply_t* rep = xcb_intern_atom_reply(conn, netWmNameCookie, NULL);
+    atomNetWmName = rep!=nullptr ? rep->atom : XCB_NONE;
+    ::free(rep);
+    rep = xcb_intern_atom_reply(conn, utf8StringCookie, NULL);
+    atomUtf8String = rep!=nullptr ? rep->atom : XCB_NONE;
+    ::free(rep);
+    return true;
+}
+
+std::string XWindowBatch::getReplyString(xcb_get_property_reply_t* rep)
+{
+    if(rep==nullptr || rep->format!=8) return "";
+    return std::string((const char*)xcb_get_property_value(rep), xcb_get_property_value_length(rep));
+}
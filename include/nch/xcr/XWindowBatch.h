@@ -0,0 +1,39 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include <vector>
+#include <xcb/xcb.h>
+
+namespace nch {
+/// @brief Result of one window within a batch query.
+struct WindowGeometry {
+    Window id = None;
+    bool ok = false;        //False if any request for this window failed (ex: it was destroyed). The other windows of the batch are unaffected.
+    int errorCode = 0;      //X error code of the first failed request (3 = BadWindow, 9 = BadDrawable), or -1 if a request failed without an X error.
+    bool noConnection = false;  //True if the window couldn't be queried at all because there is no (working) xcb connection. 'ok' is false then.
+    nch::Rect rect;         //Absolute position (relative to the root window) and size, like XTools::getWindowRect().
+    bool viewable = false;  //Only set if requested
+    std::string title;      //Only set if requested: _NET_WM_NAME, or WM_NAME if that is missing.
+};
+
+class XWindowBatch {
+public:
+    /// @brief Query the geometry of many windows at once over a dedicated xcb connection.
+    /// @brief Every GetGeometry/TranslateCoordinates (+ GetWindowAttributes/GetProperty) request is sent back-to-back before any reply is read,
+    /// @brief so the whole batch costs a single round-trip to the X server instead of one (or one process spawn) per window.
+    /// @param wins The windows to query.
+    /// @param withViewable Also fetch whether each window is viewable.
+    /// @param withTitles Also fetch the title of each window.
+    /// @return One result per window, in the same order as 'wins'.
+    static std::vector<WindowGeometry> query(const std::vector<Window>& wins, bool withViewable = false, bool withTitles = false);
+    /// @brief Close the xcb connection (reopened on the next 'query()').
+    static void free();
+private:
+    static bool ensureConnection();
+    static std::string getReplyString(xcb_get_property_reply_t* rep);
+
+    static xcb_connection_t* conn;
+    static xcb_window_t root;
+    static xcb_atom_t atomNetWmName, atomUtf8String;
+}; }
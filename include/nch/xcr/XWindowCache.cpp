@@ -0,0 +1,327 @@
+#include "XWindowCache.h"
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <algorithm>
+#include <nch/cpp-utils/log.h>
+#include <poll.h>
+#include <regex>
+#include <stdlib.h>
+#include <set>
+#include "XErrorTrap.h"
+
+using namespace nch;
+
+Display* XWindowCache::disp = nullptr;
+std::thread XWindowCache::thread;
+std::atomic<bool> XWindowCache::running(false);
+std::mutex XWindowCache::mtx;
+std::condition_variable XWindowCache::changed;
+uint64_t XWindowCache::generation = 0;
+std::map<Window, CachedWindow> XWindowCache::windows;
+Window XWindowCache::activeWindow = None;
+Atom XWindowCache::atomClientList = None;
+Atom XWindowCache::atomClientListStacking = None;
+Atom XWindowCache::atomActiveWindow = None;
+Atom XWindowCache::atomNetWmName = None;
+Atom XWindowCache::atomUtf8String = None;
+
+bool XWindowCache::start()
+{
+    if(running) return true;
+
+    disp = XOpenDisplay(NULL);
+    if(disp==nullptr) {
+        Log::error(__PRETTY_FUNCTION__, "Failed to open display...");
+        return false;
+    }
+    //Windows vanish all the time - errors on this connection are expected and ignored
+    XErrorTrap::ignoreDisplay(disp, true);
+
+    atomClientList = XInternAtom(disp, "_NET_CLIENT_LIST", False);
+    atomClientListStacking = XInternAtom(disp, "_NET_CLIENT_LIST_STACKING", False);
+    atomActiveWindow = XInternAtom(disp, "_NET_ACTIVE_WINDOW", False);
+    atomNetWmName = XInternAtom(disp, "_NET_WM_NAME", False);
+    atomUtf8String = XInternAtom(disp, "UTF8_STRING", False);
+
+    //Listen to the root window before the initial scan so nothing is missed in between
+    XSelectInput(disp, DefaultRootWindow(disp), SubstructureNotifyMask|PropertyChangeMask);
+    refreshClientList();
+    refreshStacking();
+    std::vector<unsigned long> active = getRootU32s(atomActiveWindow);
+    activeWindow = active.empty() ? None : (Window)active[0];
+
+    running = true;
+    thread = std::thread(run);
+    //A still-running std::thread would call std::terminate() when destroyed at exit
+    static bool stopRegistered = false;
+    if(!stopRegistered) {
+        std::atexit(stop);
+        stopRegistered = true;
+    }
+    return true;
+}
+
+void XWindowCache::stop()
+{
+    if(!running) return;
+    running = false;
+    thread.join();
+
+    //Let the last errors arrive (and be ignored) first: once closed, the same Display* address may be handed out to another connection, whose errors must not be ignored
+    XSync(disp, True);
+    XErrorTrap::ignoreDisplay(disp, false);
+    XCloseDisplay(disp);
+    disp = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        windows.clear();
+        activeWindow = None;
+        generation++;
+    }
+    changed.notify_all();
+}
+
+bool XWindowCache::isRunning() { return running; }
+
+std::vector<CachedWindow> XWindowCache::getWindows()
+{
+    std::vector<CachedWindow> res;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for(auto& w : windows) res.push_back(w.second);
+    }
+    std::stable_sort(res.begin(), res.end(), [](const CachedWindow& a, const CachedWindow& b) { return a.stackIndex<b.stackIndex; });
+    return res;
+}
+
+bool XWindowCache::getWindow(Window win, CachedWindow& res)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto itr = windows.find(win);
+    if(itr==windows.end()) return false;
+    res = itr->second;
+    return true;
+}
+
+Window XWindowCache::getActiveWindow()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return activeWindow;
+}
+
+std::vector<Window> XWindowCache::findWindowsByTitle(const std::string& pattern) { return findWindows(pattern, true); }
+std::vector<Window> XWindowCache::findWindowsByClassName(const std::string& pattern) { return findWindows(pattern, false); }
+
+uint64_t XWindowCache::getGeneration()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return generation;
+}
+
+bool XWindowCache::waitForChange(uint64_t& gen, int timeoutMS)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    uint64_t prev = gen;
+    changed.wait_for(lock, std::chrono::milliseconds(timeoutMS), [prev]() { return generation!=prev || !running; });
+    gen = generation;
+    return gen!=prev && running;
+}
+
+void XWindowCache::run()
+{
+    int fd = ConnectionNumber(disp);
+    while(running) {
+        bool processed = false;
+        while(XPending(disp)>0) {
+            XEvent ev;
+            XNextEvent(disp, &ev);
+            processEvent(ev);
+            processed = true;
+        }
+        //Wake up anyone waiting on a change (once per batch of events)
+        if(processed) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                generation++;
+            }
+            changed.notify_all();
+        }
+
+        //Wait for more events, waking up regularly to check if we should stop
+        pollfd pfd;
+        pfd.fd = fd; pfd.events = POLLIN; pfd.revents = 0;
+        poll(&pfd, 1, 100);
+    }
+}
+
+void XWindowCache::processEvent(XEvent& ev)
+{
+    Window root = DefaultRootWindow(disp);
+
+    switch(ev.type) {
+        case PropertyNotify: {
+            Window win = ev.xproperty.window;
+            Atom atom = ev.xproperty.atom;
+            if(win==root) {
+                if(atom==atomClientList)            refreshClientList();
+                if(atom==atomClientListStacking)    refreshStacking();
+                if(atom==atomActiveWindow) {
+                    std::vector<unsigned long> active = getRootU32s(atomActiveWindow);
+                    std::lock_guard<std::mutex> lock(mtx);
+                    activeWindow = active.empty() ? None : (Window)active[0];
+                }
+            } else if(atom==XA_WM_NAME || atom==atomNetWmName || atom==XA_WM_CLASS) {
+                CachedWindow cw;
+                if(!getWindow(win, cw)) break;
+                refreshWindowProps(win, cw);
+                std::lock_guard<std::mutex> lock(mtx);
+                if(windows.count(win)) windows[win] = cw;
+            }
+        } break;
+        case ConfigureNotify:
+        case MapNotify:
+        case UnmapNotify: {
+            Window win = ev.xany.window;
+            CachedWindow cw;
+            if(!getWindow(win, cw)) break;
+            if(ev.type==MapNotify)      cw.mapped = true;
+            if(ev.type==UnmapNotify)    cw.mapped = false;
+            refreshWindowRect(win, cw);
+            std::lock_guard<std::mutex> lock(mtx);
+            if(windows.count(win)) windows[win] = cw;
+        } break;
+        case DestroyNotify: {
+            std::lock_guard<std::mutex> lock(mtx);
+            windows.erase(ev.xdestroywindow.window);
+        } break;
+        case CreateNotify: {
+            //Without an EWMH window manager there is no _NET_CLIENT_LIST, so track new top-level windows directly
+            if(ev.xcreatewindow.parent==root && getRootU32s(atomClientList).empty()) {
+                trackWindow(ev.xcreatewindow.window);
+            }
+        } break;
+    }
+}
+
+void XWindowCache::refreshClientList()
+{
+    std::vector<unsigned long> clients = getRootU32s(atomClientList);
+    if(clients.empty()) {
+        //Non-EWMH fallback: direct children of the root window
+        Window rootRet, parRet; Window* children = nullptr; unsigned int numChildren = 0;
+        if(XQueryTree(disp, DefaultRootWindow(disp), &rootRet, &parRet, &children, &numChildren)) {
+            for(unsigned int i = 0; i<numChildren; i++) clients.push_back(children[i]);
+            if(children!=nullptr) XFree(children);
+        }
+    }
+
+    //Forget windows that are gone, start tracking new ones
+    std::set<Window> current(clients.begin(), clients.end());
+    std::vector<Window> added;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for(auto itr = windows.begin(); itr!=windows.end(); ) {
+            if(current.count(itr->first)==0) itr = windows.erase(itr);
+            else itr++;
+        }
+        for(Window w : current) {
+            if(windows.count(w)==0) added.push_back(w);
+        }
+    }
+    for(Window w : added) trackWindow(w);
+}
+
+void XWindowCache::refreshStacking()
+{
+    std::vector<unsigned long> stacking = getRootU32s(atomClientListStacking);
+    std::lock_guard<std::mutex> lock(mtx);
+    for(auto& w : windows) w.second.stackIndex = -1;
+    for(size_t i = 0; i<stacking.size(); i++) {
+        auto itr = windows.find((Window)stacking[i]);
+        if(itr!=windows.end()) itr->second.stackIndex = (int)i;
+    }
+}
+
+void XWindowCache::trackWindow(Window win)
+{
+    XSelectInput(disp, win, PropertyChangeMask|StructureNotifyMask);
+
+    CachedWindow cw;
+    cw.id = win;
+    XWindowAttributes attrs;
+    if(!XGetWindowAttributes(disp, win, &attrs)) return;
+    cw.mapped = attrs.map_state==IsViewable;
+    refreshWindowProps(win, cw);
+    refreshWindowRect(win, cw);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    windows[win] = cw;
+}
+
+void XWindowCache::refreshWindowProps(Window win, CachedWindow& cw)
+{
+    cw.title = getString(win, atomNetWmName, atomUtf8String);
+    if(cw.title=="") cw.title = getString(win, XA_WM_NAME, AnyPropertyType);
+    cw.className = std::string(getString(win, XA_WM_CLASS, XA_STRING).c_str());
+}
+
+void XWindowCache::refreshWindowRect(Window win, CachedWindow& cw)
+{
+    //Event coordinates are relative to the (possibly reparented) parent, so ask for the absolute position
+    XWindowAttributes attrs;
+    if(!XGetWindowAttributes(disp, win, &attrs)) return;
+    int absX, absY; Window child;
+    if(!XTranslateCoordinates(disp, win, attrs.root, 0, 0, &absX, &absY, &child)) return;
+    cw.rect = Rect(absX, absY, attrs.width, attrs.height);
+}
+
+std::vector<unsigned long> XWindowCache::getRootU32s(Atom prop)
+{
+    std::vector<unsigned long> res;
+    Atom actualType; int actualFormat;
+    unsigned long numItems, bytesAfter;
+    unsigned char* data = nullptr;
+    int status = XGetWindowProperty(disp, DefaultRootWindow(disp), prop, 0, (~0L), False, AnyPropertyType, &actualType, &actualFormat, &numItems, &bytesAfter, &data);
+    if(status==Success && data!=nullptr && actualFormat==32) {
+        long* items = (long*)data;
+        for(unsigned long i = 0; i<numItems; i++) res.push_back((unsigned long)items[i]);
+    }
+    if(data!=nullptr) XFree(data);
+    return res;
+}
+
+std::string XWindowCache::getString(Window win, Atom prop, Atom type)
+{
+    Atom actualType; int actualFormat;
+    unsigned long numItems, bytesAfter;
+    unsigned char* data = nullptr;
+    std::string res;
+    int status = XGetWindowProperty(disp, win, prop, 0, (~0L), False, type, &actualType, &actualFormat, &numItems, &bytesAfter, &data);
+    if(status==Success && data!=nullptr && actualFormat==8) {
+        res.assign((const char*)data, numItems);
+    }
+    if(data!=nullptr) XFree(data);
+    return res;
+}
+
+std::vector<Window> XWindowCache::findWindows(const std::string& pattern, bool byTitle)
+{
+    std::vector<Window> res;
+
+    std::regex re;
+    try { re = std::regex(pattern, std::regex::extended|std::regex::icase); }
+    catch(...) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning {}", "Invalid regex \"%s\"", pattern.c_str());
+        return res;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for(auto& w : windows) {
+        if(!w.second.mapped) continue;
+        if(std::regex_search(byTitle ? w.second.title : w.second.className, re)) {
+            res.push_back(w.first);
+        }
+    }
+    return res;
+}
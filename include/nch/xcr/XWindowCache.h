@@ -0,0 +1,70 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nch {
+/// @brief Snapshot of a top-level window as seen by XWindowCache.
+struct CachedWindow {
+    Window id = None;
+    std::string title;
+    std::string className;
+    nch::Rect rect;
+    bool mapped = false;
+    int stackIndex = -1;    //Position within _NET_CLIENT_LIST_STACKING (0 = bottom), or -1 if unknown.
+};
+
+class XWindowCache {
+public:
+    /// @brief Start tracking top-level windows on a dedicated display connection and thread.
+    /// @brief The cache is kept current from CreateNotify/DestroyNotify/ConfigureNotify/PropertyNotify (+ Map/Unmap) events.
+    /// @return True if the cache is running (or already was).
+    static bool start();
+    /// @brief Stop the tracking thread and close its display connection. The cache is emptied. Also done automatically at exit.
+    static void stop();
+    static bool isRunning();
+
+    /// @return All tracked windows, ordered by stacking order (bottom to top) when the window manager provides it.
+    static std::vector<CachedWindow> getWindows();
+    /// @brief Look up a single window. @return False if the window isn't tracked.
+    static bool getWindow(Window win, CachedWindow& res);
+    /// @return The active window (_NET_ACTIVE_WINDOW), or None.
+    static Window getActiveWindow();
+    /// @brief Same as XWindowQuery::findWindowsByTitle/ByClassName but answered from memory.
+    static std::vector<Window> findWindowsByTitle(const std::string& pattern);
+    static std::vector<Window> findWindowsByClassName(const std::string& pattern);
+
+    /// @return A counter that is incremented every time the cache changes.
+    static uint64_t getGeneration();
+    /// @brief Block until the cache changes (its generation differs from 'generation'), without polling. 'generation' is updated to the new value.
+    /// @return False on timeout or if the cache isn't running.
+    static bool waitForChange(uint64_t& generation, int timeoutMS);
+private:
+    static void run();
+    static void processEvent(XEvent& ev);
+    static void refreshClientList();
+    static void refreshStacking();
+    static void trackWindow(Window win);
+    static void refreshWindowProps(Window win, CachedWindow& cw);
+    static void refreshWindowRect(Window win, CachedWindow& cw);
+    static std::vector<unsigned long> getRootU32s(Atom prop);
+    static std::string getString(Window win, Atom prop, Atom type);
+    static std::vector<Window> findWindows(const std::string& pattern, bool byTitle);
+
+    static Display* disp;
+    static std::thread thread;
+    static std::atomic<bool> running;
+    static std::mutex mtx;
+    static std::condition_variable changed;
+    static uint64_t generation;
+    static std::map<Window, CachedWindow> windows;
+    static Window activeWindow;
+
+    static Atom atomClientList, atomClientListStacking, atomActiveWindow, atomNetWmName, atomUtf8String;
+}; }
@@ -0,0 +1,156 @@
+#include "XWindowControl.h"
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <algorithm>
+#include <nch/cpp-utils/log.h>
+#include "WaitFor.h"
+#include "XNativeInput.h"
+#include "XWindowQuery.h"
+
+using namespace nch;
+
+bool XWindowControl::setState(Window win, WindowState state, bool on, int confirmTimeoutMS)
+{
+    Display* disp = XNativeInput::getDisplay();
+    if(disp==nullptr) return false;
+    Rect r;
+    if(!XWindowQuery::getWindowRect(win, r)) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Window 0x%lx doesn't exist", win);
+        return false;
+    }
+    if(!isSupported("_NET_WM_STATE")) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Window manager doesn't support _NET_WM_STATE");
+        return false;
+    }
+
+    //data.l[0]: 0 = remove, 1 = add. Source indication 2 = "pager".
+    std::vector<Atom> atoms = getStateAtoms(disp, state);
+    sendRootMessage(disp, win, XInternAtom(disp, "_NET_WM_STATE", False), on ? 1 : 0, atoms[0], atoms.size()>1 ? atoms[1] : 0, 2, 0);
+
+    if(confirmTimeoutMS<=0) return true;
+    return WaitFor::windowCondition([win, state, on]() { return hasState(win, state)==on; }, confirmTimeoutMS);
+}
+
+bool XWindowControl::hasState(Window win, WindowState state)
+{
+    Display* disp = XNativeInput::getDisplay();
+    if(disp==nullptr) return false;
+
+    std::vector<unsigned long> current = XWindowQuery::getPropertyU32s(win, "_NET_WM_STATE", XA_ATOM);
+    std::vector<Atom> atoms = getStateAtoms(disp, state);
+    for(size_t i = 0; i<atoms.size(); i++) {
+        if(std::find(current.begin(), current.end(), atoms[i])==current.end()) return false;
+    }
+    return true;
+}
+
+bool XWindowControl::maximize(Window win, bool on, int confirmTimeoutMS) {
+    return setState(win, STATE_MAXIMIZED, on, confirmTimeoutMS);
+}
+
+bool XWindowControl::activate(Window win, int confirmTimeoutMS)
+{
+    if(!XNativeInput::activateWindow((int)win)) return false;
+    if(confirmTimeoutMS<=0) return true;
+    return WaitFor::windowFocused(win, confirmTimeoutMS);
+}
+
+bool XWindowControl::moveResize(Window win, const Rect& rect, int confirmTimeoutMS)
+{
+    Display* disp = XNativeInput::getDisplay();
+    if(disp==nullptr) return false;
+    Rect before;
+    if(!XWindowQuery::getWindowRect(win, before)) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Window 0x%lx doesn't exist", win);
+        return false;
+    }
+
+    if(isSupported("_NET_MOVERESIZE_WINDOW")) {
+        //data.l[0]: gravity (bits 0-7, StaticGravity = client area coordinates), x/y/w/h present (bits 8-11), source indication 2 (bits 12-15)
+        long flags = StaticGravity|(0xf<<8)|(2<<12);
+        sendRootMessage(disp, win, XInternAtom(disp, "_NET_MOVERESIZE_WINDOW", False), flags, rect.r.x, rect.r.y, rect.r.w, rect.r.h);
+    } else {
+        XMoveResizeWindow(disp, win, rect.r.x, rect.r.y, rect.r.w, rect.r.h);
+        XFlush(disp);
+    }
+
+    if(confirmTimeoutMS<=0) return true;
+    //Window managers may adjust the request (ex: minimum sizes): any new geometry means it was handled
+    return WaitFor::windowCondition([win, rect, before]() {
+        Rect r;
+        return XWindowQuery::getWindowRect(win, r) && (r==rect || !(r==before));
+    }, confirmTimeoutMS);
+}
+
+bool XWindowControl::setTitle(Window win, const std::string& title)
+{
+    Display* disp = XNativeInput::getDisplay();
+    if(disp==nullptr) return false;
+    Rect r;
+    if(!XWindowQuery::getWindowRect(win, r)) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "Window 0x%lx doesn't exist", win);
+        return false;
+    }
+
+    //_NET_WM_NAME is what EWMH window managers/taskbars show, WM_NAME is for everything else
+    Atom netWmName = XInternAtom(disp, "_NET_WM_NAME", False);
+    Atom utf8String = XInternAtom(disp, "UTF8_STRING", False);
+    XChangeProperty(disp, win, netWmName, utf8String, 8, PropModeReplace, (const unsigned char*)title.c_str(), title.size());
+    //WM_NAME must not hold raw UTF-8: this encodes it as STRING (Latin-1) if possible, COMPOUND_TEXT otherwise
+    XTextProperty wmName;
+    char* list[1] = { (char*)title.c_str() };
+    int status = Xutf8TextListToTextProperty(disp, list, 1, XStdICCTextStyle, &wmName);
+    if(status>=Success && wmName.value!=nullptr) {
+        XSetWMName(disp, win, &wmName);
+        XFree(wmName.value);
+    } else {
+        Log::warnv(__PRETTY_FUNCTION__, "skipping WM_NAME", "Xutf8TextListToTextProperty() failed (%d)", status);
+    }
+    XFlush(disp);
+    return true;
+}
+
+bool XWindowControl::isSupported(const char* atomName)
+{
+    Display* disp = XNativeInput::getDisplay();
+    if(disp==nullptr) return false;
+
+    Atom atom = XInternAtom(disp, atomName, True);
+    if(atom==None) return false;
+    std::vector<unsigned long> supported = XWindowQuery::getPropertyU32s(DefaultRootWindow(disp), "_NET_SUPPORTED", XA_ATOM);
+    return std::find(supported.begin(), supported.end(), atom)!=supported.end();
+}
+
+std::vector<Atom> XWindowControl::getStateAtoms(Display* disp, WindowState state)
+{
+    std::vector<Atom> res;
+    switch(state) {
+        case STATE_MAXIMIZED: {
+            res.push_back(XInternAtom(disp, "_NET_WM_STATE_MAXIMIZED_VERT", False));
+            res.push_back(XInternAtom(disp, "_NET_WM_STATE_MAXIMIZED_HORZ", False));
+        } break;
+        case STATE_FULLSCREEN:  res.push_back(XInternAtom(disp, "_NET_WM_STATE_FULLSCREEN", False)); break;
+        case STATE_ABOVE:       res.push_back(XInternAtom(disp, "_NET_WM_STATE_ABOVE", False)); break;
+        case STATE_BELOW:       res.push_back(XInternAtom(disp, "_NET_WM_STATE_BELOW", False)); break;
+        case STATE_STICKY:      res.push_back(XInternAtom(disp, "_NET_WM_STATE_STICKY", False)); break;
+    }
+    return res;
+}
+
+void XWindowControl::sendRootMessage(Display* disp, Window win, Atom type, long l0, long l1, long l2, long l3, long l4)
+{
+    XEvent ev = {};
+    ev.xclient.type = ClientMessage;
+    ev.xclient.serial = 0;
+    ev.xclient.send_event = True;
+    ev.xclient.window = win;
+    ev.xclient.message_type = type;
+    ev.xclient.format = 32;
+    ev.xclient.data.l[0] = l0;
+    ev.xclient.data.l[1] = l1;
+    ev.xclient.data.l[2] = l2;
+    ev.xclient.data.l[3] = l3;
+    ev.xclient.data.l[4] = l4;
+    XSendEvent(disp, DefaultRootWindow(disp), False, SubstructureRedirectMask|SubstructureNotifyMask, &ev);
+    XFlush(disp);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include <vector>
+
+namespace nch { class XWindowControl {
+public:
+    /// @brief Window states that can be requested through _NET_WM_STATE.
+    enum WindowState {
+        STATE_MAXIMIZED,    //_NET_WM_STATE_MAXIMIZED_VERT + _NET_WM_STATE_MAXIMIZED_HORZ
+        STATE_FULLSCREEN,   //_NET_WM_STATE_FULLSCREEN
+        STATE_ABOVE,        //_NET_WM_STATE_ABOVE
+        STATE_BELOW,        //_NET_WM_STATE_BELOW
+        STATE_STICKY,       //_NET_WM_STATE_STICKY
+    };
+
+    /// All requests below are sent natively to the window manager (EWMH client messages) - no xdotool, no mouse clicks.
+    /// If 'confirmTimeoutMS' > 0, they block until the window manager has applied the request (see WaitFor::windowCondition()).
+    /// @return True once confirmed (or once sent, if 'confirmTimeoutMS' is 0). False if there is no display, the window manager doesn't support the request, or confirmation timed out.
+
+    /// @brief Add (on=true) or remove (on=false) 'state' on the window 'win' by sending a _NET_WM_STATE request.
+    static bool setState(Window win, WindowState state, bool on, int confirmTimeoutMS = 500);
+    /// @return Whether 'win' currently has 'state' (read from its _NET_WM_STATE property).
+    static bool hasState(Window win, WindowState state);
+    /// @brief Shorthand for 'setState(win, STATE_MAXIMIZED, on, ...)'.
+    static bool maximize(Window win, bool on = true, int confirmTimeoutMS = 500);
+    /// @brief Activate (raise + focus) 'win' through _NET_ACTIVE_WINDOW (see XNativeInput::activateWindow()).
+    static bool activate(Window win, int confirmTimeoutMS = 500);
+    /// @brief Move and resize the client area of 'win' to 'rect' (absolute coordinates). Uses _NET_MOVERESIZE_WINDOW when the window manager supports it, XMoveResizeWindow() otherwise.
+    /// @brief Confirmed once the window's rect is 'rect' or has changed at all: window managers may adjust the request (ex: minimum sizes), and that geometry is accepted.
+    static bool moveResize(Window win, const nch::Rect& rect, int confirmTimeoutMS = 500);
+    /// @brief Set the title of 'win': _NET_WM_NAME (UTF-8) and WM_NAME.
+    static bool setTitle(Window win, const std::string& title);
+
+    /// @return Whether the window manager lists the atom 'atomName' in _NET_SUPPORTED.
+    static bool isSupported(const char* atomName);
+private:
+    static std::vector<Atom> getStateAtoms(Display* disp, WindowState state);
+    static void sendRootMessage(Display* disp, Window win, Atom type, long l0, long l1, long l2, long l3, long l4);
+}; }
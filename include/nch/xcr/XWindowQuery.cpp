@@ -0,0 +1,192 @@
+#include "XWindowQuery.h"
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <nch/cpp-utils/log.h>
+#include <regex>
+#include "XErrorTrap.h"
+
+using namespace nch;
+
+std::recursive_mutex XWindowQuery::mtx;
+Display* XWindowQuery::queryDisp = nullptr;
+
+std::vector<Window> XWindowQuery::getClientWindows()
+{
+    std::vector<Window> res;
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return res;
+
+    std::vector<unsigned long> clients = getPropertyU32s(DefaultRootWindow(disp), "_NET_CLIENT_LIST", XA_WINDOW);
+    if(!clients.empty()) {
+        res.assign(clients.begin(), clients.end());
+        return res;
+    }
+
+    //Not an EWMH window manager: fall back to every window in the tree
+    XErrorTrap trap(disp);
+    addTreeWindows(disp, DefaultRootWindow(disp), res);
+    return res;
+}
+
+std::string XWindowQuery::getWindowTitle(Window win)
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return "";
+
+    std::string res = getPropertyString(win, "_NET_WM_NAME", XInternAtom(disp, "UTF8_STRING", False));
+    if(res=="") res = getPropertyString(win, "WM_NAME", AnyPropertyType);
+    return res;
+}
+
+std::string XWindowQuery::getWindowClassName(Window win)
+{
+    //WM_CLASS is two null-terminated strings: instance name, then class name
+    std::string wmClass = getPropertyString(win, "WM_CLASS", XA_STRING);
+    return std::string(wmClass.c_str());
+}
+
+bool XWindowQuery::getWindowRect(Window win, Rect& res)
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return false;
+
+    XErrorTrap trap(disp);
+    XWindowAttributes attrs;
+    if(!XGetWindowAttributes(disp, win, &attrs) || trap.failed()) return false;
+    int absX, absY; Window child;
+    if(!XTranslateCoordinates(disp, win, attrs.root, 0, 0, &absX, &absY, &child) || trap.failed()) return false;
+
+    res = Rect(absX, absY, attrs.width, attrs.height);
+    return true;
+}
+
+bool XWindowQuery::isWindowViewable(Window win)
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return false;
+
+    XErrorTrap trap(disp);
+    XWindowAttributes attrs;
+    if(!XGetWindowAttributes(disp, win, &attrs) || trap.failed()) return false;
+    return attrs.map_state==IsViewable;
+}
+
+Window XWindowQuery::getActiveWindow()
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return None;
+
+    std::vector<unsigned long> active = getPropertyU32s(DefaultRootWindow(disp), "_NET_ACTIVE_WINDOW", XA_WINDOW);
+    if(active.empty()) return None;
+    return (Window)active[0];
+}
+
+std::vector<Window> XWindowQuery::findWindowsByTitle(const std::string& pattern) { return findWindows(pattern, true); }
+std::vector<Window> XWindowQuery::findWindowsByClassName(const std::string& pattern) { return findWindows(pattern, false); }
+
+std::vector<unsigned long> XWindowQuery::getPropertyU32s(Window win, const char* propName, Atom type)
+{
+    std::vector<unsigned long> res;
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return res;
+
+    XErrorTrap trap(disp);
+    Atom prop = XInternAtom(disp, propName, True);
+    if(prop==None) return res;
+
+    Atom actualType; int actualFormat;
+    unsigned long numItems, bytesAfter;
+    unsigned char* data = nullptr;
+    int status = XGetWindowProperty(disp, win, prop, 0, (~0L), False, type, &actualType, &actualFormat, &numItems, &bytesAfter, &data);
+    if(status==Success && data!=nullptr && actualFormat==32) {
+        //Format 32 properties are returned as arrays of 'long', regardless of the platform
+        long* items = (long*)data;
+        for(unsigned long i = 0; i<numItems; i++) res.push_back((unsigned long)items[i]);
+    }
+    if(data!=nullptr) XFree(data);
+    return res;
+}
+
+std::string XWindowQuery::getPropertyString(Window win, const char* propName, Atom type)
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    Display* disp = getDisplay();
+    if(disp==nullptr) return "";
+
+    XErrorTrap trap(disp);
+    Atom prop = XInternAtom(disp, propName, True);
+    if(prop==None) return "";
+
+    Atom actualType; int actualFormat;
+    unsigned long numItems, bytesAfter;
+    unsigned char* data = nullptr;
+    std::string res;
+    int status = XGetWindowProperty(disp, win, prop, 0, (~0L), False, type, &actualType, &actualFormat, &numItems, &bytesAfter, &data);
+    if(status==Success && data!=nullptr && actualFormat==8) {
+        res.assign((const char*)data, numItems);
+    }
+    if(data!=nullptr) XFree(data);
+    return res;
+}
+
+std::vector<Window> XWindowQuery::findWindows(const std::string& pattern, bool byTitle)
+{
+    std::vector<Window> res;
+
+    std::regex re;
+    try { re = std::regex(pattern, std::regex::extended|std::regex::icase); }
+    catch(...) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning {}", "Invalid regex \"%s\"", pattern.c_str());
+        return res;
+    }
+
+    std::vector<Window> wins = getClientWindows();
+    for(size_t i = 0; i<wins.size(); i++) {
+        if(!isWindowViewable(wins[i])) continue;
+        std::string str = byTitle ? getWindowTitle(wins[i]) : getWindowClassName(wins[i]);
+        if(std::regex_search(str, re)) {
+            res.push_back(wins[i]);
+        }
+    }
+    return res;
+}
+
+void XWindowQuery::free()
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if(queryDisp==nullptr) return;
+    XCloseDisplay(queryDisp);
+    queryDisp = nullptr;
+}
+
+Display* XWindowQuery::getDisplay()
+{
+    std::lock_guard<std::recursive_mutex> lock(mtx);
+    if(queryDisp==nullptr) {
+        queryDisp = XOpenDisplay(NULL);
+        if(queryDisp==nullptr) {
+            Log::error(__PRETTY_FUNCTION__, "Failed to open display...");
+        }
+    }
+    return queryDisp;
+}
+
+void XWindowQuery::addTreeWindows(Display* disp, Window parent, std::vector<Window>& res)
+{
+    Window root, par;
+    Window* children = nullptr;
+    unsigned int numChildren = 0;
+    if(!XQueryTree(disp, parent, &root, &par, &children, &numChildren)) return;
+
+    for(unsigned int i = 0; i<numChildren; i++) {
+        res.push_back(children[i]);
+        addTreeWindows(disp, children[i], res);
+    }
+    if(children!=nullptr) XFree(children);
+}
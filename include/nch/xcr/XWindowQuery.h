@@ -0,0 +1,47 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <mutex>
+#include <nch/sdl-utils/rect.h>
+#include <string>
+#include <vector>
+
+namespace nch { class XWindowQuery {
+public:
+    /// Queries use a connection of their own, one query at a time, so the X errors trapped while querying (ex: BadWindow for a window that just closed)
+    /// can only come from the query itself and never from requests that other threads send at the same time (ex: input on XNativeInput's display).
+    /// @brief Get all top-level client windows managed by the window manager (_NET_CLIENT_LIST), in mapping order.
+    /// @brief If the window manager doesn't provide _NET_CLIENT_LIST, walks the whole window tree instead.
+    static std::vector<Window> getClientWindows();
+    /// @return The title of the window (_NET_WM_NAME, or WM_NAME if that is missing). Returns "" on failure.
+    static std::string getWindowTitle(Window win);
+    /// @return The instance name of the window (first part of WM_CLASS), which is what "xdotool search --classname" matches. Returns "" on failure.
+    static std::string getWindowClassName(Window win);
+    /// @brief Get the absolute position (relative to the root window) and size of a window, like 'xwininfo' does.
+    /// @param res Set to the window's rectangle on success.
+    /// @return True on success, false if the window doesn't exist (anymore).
+    static bool getWindowRect(Window win, nch::Rect& res);
+    /// @return Whether the window is currently viewable (mapped, along with all of its ancestors).
+    static bool isWindowViewable(Window win);
+    /// @return The currently active window (_NET_ACTIVE_WINDOW), or None if there is none.
+    static Window getActiveWindow();
+
+    /// @brief Find viewable windows whose title/class name match the extended, case-insensitive regex 'pattern' (same rules as "xdotool search --onlyvisible").
+    static std::vector<Window> findWindowsByTitle(const std::string& pattern);
+    static std::vector<Window> findWindowsByClassName(const std::string& pattern);
+
+    /// @brief Read a window property made of 32-bit items (CARDINAL, WINDOW, ATOM, ...). Returns an empty list if the property is missing.
+    static std::vector<unsigned long> getPropertyU32s(Window win, const char* propName, Atom type);
+    /// @brief Read a window property made of 8-bit items (STRING, UTF8_STRING). Returns "" if the property is missing.
+    static std::string getPropertyString(Window win, const char* propName, Atom type);
+
+    /// @brief Close the connection used for queries (if open). The next query reopens it.
+    static void free();
+private:
+    /// @return The connection used for queries, opened on first use. Callers hold 'mtx' for as long as they use it.
+    static Display* getDisplay();
+    static std::vector<Window> findWindows(const std::string& pattern, bool byTitle);
+    static void addTreeWindows(Display* disp, Window parent, std::vector<Window>& res);
+
+    static std::recursive_mutex mtx;    //Held for the whole of each query
+    static Display* queryDisp;
+}; }
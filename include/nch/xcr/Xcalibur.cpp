@@ -1,8 +1,18 @@
 #include "Xcalibur.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <nch/cpp-utils/log.h>
 #include <nch/cpp-utils/timer.h>
 #include <nch/sdl-utils/texture-utils.h>
 #include <nch/xcr/MiscTools.h>
+#include "InputExecutor.h"
+#include "InputScheduler.h"
+#include "MouseTrajectory.h"
+#include "OCRWorkerPool.h"
+#include "PointerSampler.h"
+#include "XKeymap.h"
+#include "XWindowCache.h"
 
 using namespace nch;
 
@@ -10,17 +20,25 @@ bool Xcalibur::initted = false;
 SDL_Texture* Xcalibur::screenTex = nullptr;
 SDL_Surface* Xcalibur::screenSurf = nullptr;
 SDL_Renderer* Xcalibur::rend = nullptr;
+std::vector<uint8_t> Xcalibur::texShadow;
+std::vector<nch::Rect> Xcalibur::texDirtyRects;
+bool Xcalibur::pixMaskReady = false;
 
 XImage* Xcalibur::ximg = nullptr;
 Display* Xcalibur::disp = nullptr;
 XShmSegmentInfo Xcalibur::shmSegInfo;
 Rect Xcalibur::dispArea;
-
-std::set<std::pair<int, int>> Xcalibur::pixSet;
-std::map<std::pair<int, int>, nch::Color> Xcalibur::pixDiffs;
+XImage* Xcalibur::areaImg = nullptr;
+XShmSegmentInfo Xcalibur::areaShmSegInfo;
+std::mutex Xcalibur::areaMtx;
+
+RegionMask Xcalibur::pixMask;
+std::vector<PixDiffRun> Xcalibur::diffRuns;
+std::vector<uint32_t> Xcalibur::diffPixBuf;
+uint64_t Xcalibur::numDiffPixels = 0;
 std::vector<nch::Rect> Xcalibur::ignoredPixAreas;
 
-void Xcalibur::init(SDL_Renderer* rend, const Rect& displayArea)
+void Xcalibur::init(SDL_Renderer* rend, const Rect& displayArea, int features)
 {
     /* Init members */
     if(initted) {
@@ -29,11 +47,10 @@ void Xcalibur::init(SDL_Renderer* rend, const Rect& displayArea)
     }
     Xcalibur::rend = rend;
 
-    /* Open clipboard */
-    MiscTools::globalInitLibclipboard();
-
     /* Open/Setup X11 display */
     {
+        //Other parts of Xcalibur (window cache, input scheduling) use Xlib from their own threads
+        XInitThreads();
         //Open display
         disp = XOpenDisplay(NULL);
         if(disp==NULL) {
@@ -79,27 +96,13 @@ void Xcalibur::init(SDL_Renderer* rend, const Rect& displayArea)
         }
     }
 
-    /* Create SDL Texture to stream to */
-    screenTex = SDL_CreateTexture(rend, SDL_PIXELFORMAT_BGRA32, SDL_TEXTUREACCESS_STREAMING, dispArea.r.w, dispArea.r.h);
-    if(screenTex==NULL) {
-        Log::errorv(__PRETTY_FUNCTION__, "SDL_CreateTexture()", SDL_GetError());
-        return;
-    }
-    screenSurf = SDL_CreateRGBSurfaceWithFormat(0, dispArea.r.w, dispArea.r.h, 32, SDL_PIXELFORMAT_BGRA32);
-    if(screenSurf==NULL) {
-        Log::errorv(__PRETTY_FUNCTION__, "SDL_CreateRGBSurfaceWithFormat()", SDL_GetError());
-        return;
-    }
-    for(int ix = 0; ix<screenSurf->w; ix++) {
-    for(int iy = 0; iy<screenSurf->h; iy++) {
-        TexUtils::setPixelColor(screenSurf, ix, iy, Color(255, 0, 0).getRGBA());
-    }}
-
     /* Valid init by this point */
     initted = true;
 
-    /* Pixel set */
-    resetPixSet();
+    /* Everything else is created on first use, unless requested up front */
+    if(features&FEATURE_CLIPBOARD)  MiscTools::globalInitLibclipboard();
+    if(features&FEATURE_SCREEN_TEX) ensureScreenTex();
+    if(features&FEATURE_PIX_DIFFS)  { ensureScreenSurf(); ensurePixMask(); }
 }
 
 void Xcalibur::free()
@@ -109,18 +112,43 @@ void Xcalibur::free()
         return;
     }
 
-    /* Close clipboard */
-    MiscTools::globalFreeLibclipboard();
+    /* Background threads (finish queued input first) */
+    InputExecutor::stop();
+    InputScheduler::stopAll();              //Scripts and motions use this display through XNativeInput
+    MouseTrajectory::cancelAll();
+    XWindowCache::stop();
+    OCRWorkerPool::stop();
+    PointerSampler::stop();
+    XKeymap::flushScratchKey(disp, true);   //Unbind the scratch key (if a restore is pending) while the display is still open
+
+    /* Close clipboard (if it was ever opened) */
+    if(MiscTools::isLibclipboardOpen()) {
+        MiscTools::globalFreeLibclipboard();
+    }
 
     /* Pointers */
     SDL_DestroyTexture(screenTex);  //Destroy screen texture
     SDL_FreeSurface(screenSurf);    //Destroy previous screen surface
+    screenTex = nullptr;
+    screenSurf = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(areaMtx);
+        freeAreaImg();              //Destroy area image (if any)
+    }
     XDestroyImage(ximg);            //Destroy image
     XShmDetach(disp, &shmSegInfo);  //Shared memory detatch from display
     XCloseDisplay(disp);            //Destroy display
+    ximg = nullptr;
+    disp = nullptr;
 
     /* Other states */
-    pixSet.clear();
+    texShadow.clear(); texShadow.shrink_to_fit();
+    texDirtyRects.clear();
+    pixMask.reset(0, 0, false);
+    pixMaskReady = false;
+    diffRuns.clear(); diffRuns.shrink_to_fit();
+    diffPixBuf.clear(); diffPixBuf.shrink_to_fit();
+    numDiffPixels = 0;
     ignoredPixAreas.clear();
     initted = false;
 }
@@ -132,21 +160,40 @@ void Xcalibur::updatePixDiffs()
         return;   
     }
 
+    if(!ensureScreenSurf()) return;
+    ensurePixMask();
     Xcalibur::streamScreen();
 
-    pixDiffs.clear();
-    for(auto pixLoc : pixSet) {
-        Color px0 = TexUtils::getPixelColor(screenSurf, pixLoc.first, pixLoc.second);
-        Color px1 = TexUtils::getPixelColor((void*)ximg->data, screenSurf->format, ximg->bytes_per_line, pixLoc.first, pixLoc.second);
-        
-        if(pixLoc==std::make_pair(0, 0)) {
-            //printf("breakpoint\n");
-        }
-
-        if(px0!=px1) {
-            pixDiffs.insert({{pixLoc.first, pixLoc.second}, px1});
+    //Preallocate room for every pixel once, so that 'PixDiffRun::pixels' never dangles because of a reallocation
+    diffRuns.clear();
+    diffPixBuf.clear();
+    diffPixBuf.reserve((size_t)dispArea.r.w*dispArea.r.h);
+    numDiffPixels = 0;
+
+    const uint8_t* oldPixels = static_cast<uint8_t*>(screenSurf->pixels);
+    const uint8_t* newPixels = static_cast<uint8_t*>((void*)ximg->data);
+    pixMask.forEachSpan([&](int y, int x0, int x1) {
+        const uint32_t* oldRow = (const uint32_t*)(oldPixels + y*screenSurf->pitch);
+        const uint32_t* newRow = (const uint32_t*)(newPixels + y*ximg->bytes_per_line);
+        //Skip unchanged spans entirely
+        if(memcmp(oldRow+x0, newRow+x0, (x1-x0)*sizeof(uint32_t))==0) return;
+
+        //Record each run of consecutive changed pixels
+        int x = x0;
+        while(x<x1) {
+            while(x<x1 && oldRow[x]==newRow[x]) x++;
+            int runStart = x;
+            while(x<x1 && oldRow[x]!=newRow[x]) x++;
+            if(x>runStart) {
+                PixDiffRun run;
+                run.y = y; run.x0 = runStart; run.x1 = x;
+                run.pixels = diffPixBuf.data()+diffPixBuf.size();
+                diffPixBuf.insert(diffPixBuf.end(), newRow+runStart, newRow+x);
+                diffRuns.push_back(run);
+                numDiffPixels += (x-runStart);
+            }
         }
-    }
+    });
 }
 void Xcalibur::resetScreenSurf()
 {
@@ -155,6 +202,7 @@ void Xcalibur::resetScreenSurf()
         return;   
     }
 
+    if(!ensureScreenSurf()) return;
     SDL_FillRect(screenSurf, NULL, SDL_MapRGB(screenSurf->format, 0, 0, 0));
 }
 void Xcalibur::updateScreenSurf()
@@ -164,6 +212,7 @@ void Xcalibur::updateScreenSurf()
         return;   
     }
 
+    if(!ensureScreenSurf()) return;
     Xcalibur::streamScreen();
 
     //Copy pixels from X display to SDL_Surface
@@ -180,10 +229,122 @@ void Xcalibur::streamScreen()
         return;   
     }
 
+    captureScreen();
+    //Without a renderer there is nothing to upload to (capture-only use)
+    if(ensureScreenTex()) {
+        uploadScreenTex();
+    }
+}
+
+void Xcalibur::captureScreen()
+{
     //Get ximg data from screen
     XShmGetImage(disp, RootWindow(disp, 0), ximg, dispArea.r.x, dispArea.r.y, AllPlanes);
-    //Set pixels within 'surf' with data from 'ximg'
-    SDL_UpdateTexture(screenTex, NULL, ximg->data, ximg->bytes_per_line);
+}
+
+bool Xcalibur::ensureScreenTex()
+{
+    if(screenTex!=nullptr) return true;
+    if(rend==nullptr) return false;
+
+    screenTex = SDL_CreateTexture(rend, SDL_PIXELFORMAT_BGRA32, SDL_TEXTUREACCESS_STREAMING, dispArea.r.w, dispArea.r.h);
+    if(screenTex==NULL) {
+        Log::errorv(__PRETTY_FUNCTION__, "SDL_CreateTexture()", SDL_GetError());
+        return false;
+    }
+    texShadow.clear();
+    return true;
+}
+
+bool Xcalibur::ensureScreenSurf()
+{
+    if(screenSurf!=nullptr) return true;
+
+    screenSurf = SDL_CreateRGBSurfaceWithFormat(0, dispArea.r.w, dispArea.r.h, 32, SDL_PIXELFORMAT_BGRA32);
+    if(screenSurf==NULL) {
+        Log::errorv(__PRETTY_FUNCTION__, "SDL_CreateRGBSurfaceWithFormat()", SDL_GetError());
+        return false;
+    }
+    SDL_FillRect(screenSurf, NULL, SDL_MapRGB(screenSurf->format, 255, 0, 0));
+    return true;
+}
+
+void Xcalibur::freeAreaImg()
+{
+    //Caller holds 'areaMtx'
+
+    if(areaImg==nullptr) return;
+
+    XShmDetach(disp, &areaShmSegInfo);
+    XSync(disp, False);
+    shmdt(areaShmSegInfo.shmaddr);
+    shmctl(areaShmSegInfo.shmid, IPC_RMID, 0);
+    areaImg->data = nullptr;        //Shared memory isn't owned by the image
+    XDestroyImage(areaImg);
+    areaImg = nullptr;
+}
+
+void Xcalibur::ensurePixMask()
+{
+    if(pixMaskReady) return;
+    pixMask.reset(dispArea.r.w, dispArea.r.h, true);
+    pixMaskReady = true;
+}
+
+void Xcalibur::uploadScreenTex()
+{
+    texDirtyRects.clear();
+
+    int w = dispArea.r.w;
+    int h = dispArea.r.h;
+    size_t rowBytes = (size_t)w*4;
+    const uint8_t* src = (const uint8_t*)ximg->data;
+
+    //'texShadow' holds what 'screenTex' currently looks like. If empty, the whole texture is out of date.
+    bool full = texShadow.size()!=rowBytes*h;
+    if(full) texShadow.assign(rowBytes*h, 0);
+
+    //Find bands of consecutive changed rows along with their horizontal extent
+    int bandY0 = -1, bandX0 = w, bandX1 = 0;
+    for(int y = 0; y<=h; y++) {
+        bool dirty = false;
+        if(y<h) {
+            const uint32_t* newRow = (const uint32_t*)(src+y*ximg->bytes_per_line);
+            const uint32_t* oldRow = (const uint32_t*)(texShadow.data()+y*rowBytes);
+            if(full) {
+                dirty = true; bandX0 = 0; bandX1 = w;
+            } else if(memcmp(newRow, oldRow, rowBytes)!=0) {
+                dirty = true;
+                int x0 = 0;     while(newRow[x0]==oldRow[x0]) x0++;
+                int x1 = w;     while(newRow[x1-1]==oldRow[x1-1]) x1--;
+                bandX0 = std::min(bandX0, x0);
+                bandX1 = std::max(bandX1, x1);
+            }
+        }
+
+        if(dirty && bandY0==-1) bandY0 = y;
+        if(!dirty && bandY0!=-1) {
+            texDirtyRects.push_back(Rect(bandX0, bandY0, bandX1-bandX0, y-bandY0));
+            bandY0 = -1; bandX0 = w; bandX1 = 0;
+        }
+    }
+
+    //Write each changed band straight into the locked texture memory and remember what was written
+    for(size_t i = 0; i<texDirtyRects.size(); i++) {
+        const SDL_Rect& dr = texDirtyRects[i].r;
+        void* texPixels; int texPitch;
+        if(SDL_LockTexture(screenTex, &dr, &texPixels, &texPitch)!=0) {
+            Log::errorv(__PRETTY_FUNCTION__, "SDL_LockTexture()", SDL_GetError());
+            texShadow.clear();
+            return;
+        }
+        for(int y = dr.y; y<dr.y+dr.h; y++) {
+            const uint8_t* srcRow = src+y*ximg->bytes_per_line+dr.x*4;
+            memcpy((uint8_t*)texPixels+(y-dr.y)*texPitch, srcRow, dr.w*4);
+            memcpy(texShadow.data()+y*rowBytes+dr.x*4, srcRow, dr.w*4);
+        }
+        SDL_UnlockTexture(screenTex);
+    }
 }
 
 Display* Xcalibur::getOpenedDisplay() {
@@ -215,11 +376,98 @@ nch::Color Xcalibur::getDisplayPixelColor(int x, int y) {
         return nch::Color();   
     }
     
+    if(!ensureScreenSurf())
+        return Color(0, 0, 0, 0);
     if(x<0 || x>=screenSurf->w || y<0 || y>=screenSurf->h)
         return Color(0, 0, 0, 0);
     Color c = TexUtils::getPixelColor(screenSurf, x, y); c.a = 255;
     return c;
 }
+uint64_t Xcalibur::getDisplayAreaHash(const nch::Rect& area)
+{
+    if(!initted) {
+        Log::error(__PRETTY_FUNCTION__, "Xcalibur is not initialized (Xcalibur::init)");
+        return 0;
+    }
+    if(!ensureScreenSurf()) return 0;
+
+    int x0 = std::max(area.r.x, 0), x1 = std::min(area.r.x+area.r.w, screenSurf->w);
+    int y0 = std::max(area.r.y, 0), y1 = std::min(area.r.y+area.r.h, screenSurf->h);
+
+    //64-bit FNV-1a over whole pixels, seeded with the area's dimensions
+    uint64_t res = 14695981039346656037ULL;
+    res = (res^(uint64_t)(x1-x0))*1099511628211ULL;
+    res = (res^(uint64_t)(y1-y0))*1099511628211ULL;
+    for(int y = y0; y<y1; y++) {
+        const uint32_t* row = (const uint32_t*)((uint8_t*)screenSurf->pixels+y*screenSurf->pitch);
+        for(int x = x0; x<x1; x++) {
+            res = (res^(row[x]&0x00ffffff))*1099511628211ULL;
+        }
+    }
+    return res;
+}
+bool Xcalibur::captureDisplayArea(const nch::Rect& area, std::vector<uint32_t>& res)
+{
+    if(!initted) {
+        Log::error(__PRETTY_FUNCTION__, "Xcalibur is not initialized (Xcalibur::init)");
+        return false;
+    }
+
+    int x0 = std::max(area.r.x, 0), x1 = std::min(area.r.x+area.r.w, dispArea.r.w);
+    int y0 = std::max(area.r.y, 0), y1 = std::min(area.r.y+area.r.h, dispArea.r.h);
+    if(x1<=x0 || y1<=y0) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "'area' doesn't overlap the captured area");
+        return false;
+    }
+    int w = x1-x0, h = y1-y0;
+
+    //The area image is shared by every caller (ex: WaitFor and TextEntry on background threads)
+    std::lock_guard<std::mutex> lock(areaMtx);
+
+    //(Re)create the area image if the size changed
+    if(areaImg==nullptr || areaImg->width!=w || areaImg->height!=h) {
+        freeAreaImg();
+        XImage* img = XShmCreateImage(disp, DefaultVisual(disp, 0), 24, ZPixmap, NULL, &areaShmSegInfo, w, h);
+        if(img==nullptr) {
+            Log::errorv(__PRETTY_FUNCTION__, "XShmCreateImage()", "function returned NULL");
+            return false;
+        }
+        areaShmSegInfo.shmid = shmget(IPC_PRIVATE, img->bytes_per_line*img->height, IPC_CREAT|0777);
+        if(areaShmSegInfo.shmid<0) {
+            Log::errorv(__PRETTY_FUNCTION__, "shmget()", "%s", strerror(errno));
+            XDestroyImage(img);
+            return false;
+        }
+        void* addr = shmat(areaShmSegInfo.shmid, 0, 0);
+        if(addr==(void*)-1) {
+            Log::errorv(__PRETTY_FUNCTION__, "shmat()", "%s", strerror(errno));
+            shmctl(areaShmSegInfo.shmid, IPC_RMID, 0);
+            XDestroyImage(img);
+            return false;
+        }
+        areaShmSegInfo.shmaddr = img->data = (char*)addr;
+        areaShmSegInfo.readOnly = False;
+        if(XShmAttach(disp, &areaShmSegInfo)==0) {
+            Log::errorv(__PRETTY_FUNCTION__, "XShmAttach()", "function returned error code of 0");
+            shmdt(addr);
+            shmctl(areaShmSegInfo.shmid, IPC_RMID, 0);
+            img->data = nullptr;    //Shared memory isn't owned by the image
+            XDestroyImage(img);
+            return false;
+        }
+        areaImg = img;
+    }
+
+    if(!XShmGetImage(disp, RootWindow(disp, 0), areaImg, dispArea.r.x+x0, dispArea.r.y+y0, AllPlanes)) {
+        Log::warnv(__PRETTY_FUNCTION__, "returning false", "XShmGetImage() failed");
+        return false;
+    }
+    res.resize((size_t)w*h);
+    for(int row = 0; row<h; row++) {
+        memcpy(res.data()+(size_t)row*w, areaImg->data+row*areaImg->bytes_per_line, w*sizeof(uint32_t));
+    }
+    return true;
+}
 bool Xcalibur::checkDisplayPixels(const std::vector<nch::Vec2i>& pixCoords, const nch::Color& pixColor)
 {
     if(!initted) {
@@ -236,9 +484,14 @@ bool Xcalibur::checkDisplayPixels(const std::vector<nch::Vec2i>& pixCoords, cons
     return true;
 }
 SDL_Texture* Xcalibur::getCapturedScreenTex() {
+    if(initted) ensureScreenTex();
     return screenTex;
 }
+const std::vector<nch::Rect>& Xcalibur::getScreenTexDirtyRects() {
+    return texDirtyRects;
+}
 SDL_Surface* Xcalibur::getCapturedScreenSurf() {
+    if(initted) ensureScreenSurf();
     return screenSurf;
 }
 Rect Xcalibur::getCapturedScreenRect() {
@@ -247,8 +500,72 @@ Rect Xcalibur::getCapturedScreenRect() {
 std::vector<nch::Rect> Xcalibur::getIgnoredPixAreas() {
     return ignoredPixAreas;
 }
+RegionMask& Xcalibur::getPixMask() {
+    if(initted) ensurePixMask();
+    return pixMask;
+}
 std::map<std::pair<int, int>, nch::Color> Xcalibur::getPixDiffs() {
-    return pixDiffs;
+    std::map<std::pair<int, int>, nch::Color> res;
+    if(!initted) return res;
+
+    for(size_t i = 0; i<diffRuns.size(); i++) {
+        const PixDiffRun& run = diffRuns[i];
+        for(int x = run.x0; x<run.x1; x++) {
+            uint8_t r, g, b, a;
+            SDL_GetRGBA(run.pixels[x-run.x0], screenSurf->format, &r, &g, &b, &a);
+            res.insert({{x, run.y}, Color(r, g, b, a)});
+        }
+    }
+    return res;
+}
+void Xcalibur::visitPixDiffs(const std::function<void(const PixDiffRun&)>& visitor) {
+    for(size_t i = 0; i<diffRuns.size(); i++) {
+        visitor(diffRuns[i]);
+    }
+}
+const std::vector<PixDiffRun>& Xcalibur::getPixDiffRuns() {
+    return diffRuns;
+}
+PixDiffSummary Xcalibur::getPixDiffSummary()
+{
+    PixDiffSummary res;
+    res.numChangedPixels = numDiffPixels;
+    if(diffRuns.empty()) return res;
+
+    //Mark which 32x32 tiles contain changes
+    const int ts = 32;
+    int tw = (dispArea.r.w+ts-1)/ts;
+    int th = (dispArea.r.h+ts-1)/ts;
+    std::vector<uint8_t> tiles(tw*th, 0);
+    for(size_t i = 0; i<diffRuns.size(); i++) {
+        const PixDiffRun& run = diffRuns[i];
+        for(int tx = run.x0/ts; tx<=(run.x1-1)/ts; tx++) {
+            tiles[(run.y/ts)*tw+tx] = 1;
+        }
+    }
+
+    //Merge horizontal runs of dirty tiles, then grow those downwards while the tile row below has an identical run
+    for(int ty = 0; ty<th; ty++)
+    for(int tx = 0; tx<tw; tx++) {
+        if(!tiles[ty*tw+tx]) continue;
+        int tx1 = tx;
+        while(tx1<tw && tiles[ty*tw+tx1]) tx1++;
+        int ty1 = ty+1;
+        while(ty1<th) {
+            bool same = (tx==0 || !tiles[ty1*tw+tx-1]) && (tx1==tw || !tiles[ty1*tw+tx1]);
+            for(int i = tx; same && i<tx1; i++) same = tiles[ty1*tw+i];
+            if(!same) break;
+            for(int i = tx; i<tx1; i++) tiles[ty1*tw+i] = 0;
+            ty1++;
+        }
+        for(int i = tx; i<tx1; i++) tiles[ty*tw+i] = 0;
+
+        //Clip to the captured area
+        int x = tx*ts, y = ty*ts;
+        res.dirtyRects.push_back(Rect(x, y, std::min(tx1*ts, dispArea.r.w)-x, std::min(ty1*ts, dispArea.r.h)-y));
+        tx = tx1-1;
+    }
+    return res;
 }
 
 void Xcalibur::addIgnoredPixSet(const nch::Rect& r) {
@@ -257,14 +574,19 @@ void Xcalibur::addIgnoredPixSet(const nch::Rect& r) {
         return;
     }
     
+    ensurePixMask();
     ignoredPixAreas.push_back(r);
-    for(int ix = r.x1(); ix<=r.x2(); ix++)
-    for(int iy = r.y1(); iy<=r.y2(); iy++) {
-        auto f = pixSet.find(std::make_pair(ix, iy));
-        if(f!=pixSet.end()) {
-            pixSet.erase(f);
-        }
+    //Both edges are ignored (x1()..x2(), y1()..y2()), while RegionMask rects are half-open
+    pixMask.addRect(Rect(r.x1(), r.y1(), r.x2()-r.x1()+1, r.y2()-r.y1()+1), RegionMask::EXCLUDE);
+}
+void Xcalibur::addIgnoredPixPolygon(const std::vector<nch::Vec2i>& pts) {
+    if(!initted) {
+        Log::error(__PRETTY_FUNCTION__, "Xcalibur is not initialized (Xcalibur::init)");
+        return;
     }
+
+    ensurePixMask();
+    pixMask.addPolygon(pts, RegionMask::EXCLUDE);
 }
 void Xcalibur::resetPixSet() {
     if(!initted) {
@@ -272,10 +594,7 @@ void Xcalibur::resetPixSet() {
         return;
     }
 
-    pixSet.clear();
     ignoredPixAreas.clear();
-    for(int ix = 0; ix<dispArea.r.w; ix++)
-    for(int iy = 0; iy<dispArea.r.h; iy++) {
-        pixSet.insert(std::make_pair(ix, iy));
-    }
-}
+    pixMask.reset(dispArea.r.w, dispArea.r.h, true);
+    pixMaskReady = true;
+}
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 #include <SDL2/SDL.h>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <nch/cpp-utils/color.h>
 #include <nch/math-utils/vec2.h>
 #include <nch/sdl-utils/rect.h>
-#include <set>
+#include "RegionMask.h"
 /**/
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -12,12 +14,30 @@
 #include <sys/shm.h>
 /**/
 
-namespace nch { class Xcalibur {
+namespace nch {
+/// @brief A run of changed pixels [x0, x1) within row 'y' of the captured display.
+/// @brief 'pixels' points at the (x1-x0) new pixel values (BGRA32), stored in a buffer owned by Xcalibur that stays valid until the next 'updatePixDiffs()'.
+struct PixDiffRun { int y; int x0; int x1; const uint32_t* pixels; };
+/// @brief Compact description of the last 'updatePixDiffs()' call.
+struct PixDiffSummary { uint64_t numChangedPixels = 0; std::vector<nch::Rect> dirtyRects; };
+
+class Xcalibur {
 public:
+    /// @brief Subsystems that 'init()' should create immediately. Anything not listed is created on first use.
+    enum Features {
+        FEATURE_NONE = 0,
+        FEATURE_CLIPBOARD = 1,      //libclipboard connection (used by MiscTools::lcSetClipboard)
+        FEATURE_PIX_DIFFS = 2,      //'screenSurf' and the pixel mask (used by updatePixDiffs, updateScreenSurf, ...)
+        FEATURE_SCREEN_TEX = 4,     //'screenTex' (requires an SDL_Renderer)
+        FEATURE_ALL = 7,
+    };
+
     /// @brief Initialize the Xcalibur singleton. Allows access to the screen pixels of an X11 display as specified by 'dispArea'.
-    /// @param rend The SDL_Renderer* object used to render the screen (or part of it) to an internal SDL_Texture ('screenTex').
+    /// @brief Only the display connection and the shared memory image are set up here, so a capture-only init takes milliseconds.
+    /// @param rend The SDL_Renderer* object used to render the screen (or part of it) to an internal SDL_Texture ('screenTex'). May be nullptr if 'screenTex' is never needed.
     /// @param displayArea The rectangular area of the screen we are capturing, where xy(0, 0) is the top left. If omitted, will be set to the entire screen.
-    static void init(SDL_Renderer* rend, const nch::Rect& displayArea = Rect(0, 0, -1, -1));
+    /// @param features Bitwise OR of 'Features' to create up front instead of lazily.
+    static void init(SDL_Renderer* rend, const nch::Rect& displayArea = Rect(0, 0, -1, -1), int features = FEATURE_NONE);
     /// @brief Free/destroy the Xcalibur singleton. Can be re-'init()'-ted later if needed.
     static void free();
     
@@ -30,7 +50,7 @@ public:
     /// @brief This function is relatively fast compared to 'updatePixDiffs()' (on my hardware: ~5-10ms for 1920x1080).
     static void updateScreenSurf();
     /// @brief Stream the pixels grabbed from the screen to an internal SDL_Texture ('screenTex').
-    /// @brief Use 'getScreenTex()' to get this SDL_Texture. On my hardware this function takes ~10ms for a 1920x1080 screen.
+    /// @brief Use 'getScreenTex()' to get this SDL_Texture. Only the rows that changed since the last upload are written (via SDL_LockTexture), and nothing is uploaded if the screen didn't change.
     static void streamScreen();
 
     static Display* getOpenedDisplay();
@@ -44,6 +64,17 @@ public:
     /// @param y y position of the pixel.
     /// @return The color of the specified screen pixel.
     static nch::Color getDisplayPixelColor(int x, int y);
+    /// @brief Hash the colors (ignoring alpha) of an area of the screen. Equal hashes mean the area (almost certainly) looks the same.
+    /// @brief Uses the screen from the last time 'updateScreenSurf()' was called, NOT the current screen.
+    /// @param area Rectangular area of Xcalibur's 'disp'lay to hash. Clipped to the captured area.
+    /// @return A 64-bit hash of the area's contents and size.
+    static uint64_t getDisplayAreaHash(const nch::Rect& area);
+    /// @brief Grab only 'area' of the current screen (not the whole 'dispArea'), for sampling a small region at a high rate.
+    /// @brief Uses a separate shared memory image sized to 'area', which is reused as long as the size stays the same. Does not touch 'screenSurf'.
+    /// @param area Rectangular area of Xcalibur's 'disp'lay to grab. Clipped to the captured area.
+    /// @param res Receives the area's pixels (BGRA32), row by row.
+    /// @return False if Xcalibur isn't initialized or 'area' doesn't overlap the captured area.
+    static bool captureDisplayArea(const nch::Rect& area, std::vector<uint32_t>& res);
     /// @brief Check to see if the given list of pixels ('pixCoords') match the specified color ('pixColor')
     /// @param pixCoords The list of coordinates to check.
     /// @param pixColor The color that all the pixels from 'pixCoords' should be.
@@ -51,32 +82,62 @@ public:
     static bool checkDisplayPixels(const std::vector<nch::Vec2i>& pixCoords, const nch::Color& pixColor);
     /// @return The SDL_Texture* representing the screen, which is rebuilt upon every 'streamScreen()' call.
     static SDL_Texture* getCapturedScreenTex();
+    /// @return The areas of 'screenTex' that were rewritten by the last 'streamScreen()' call (empty if nothing changed).
+    static const std::vector<nch::Rect>& getScreenTexDirtyRects();
     /// @return An SDL_Surface* which is used to calculate pixel changes. Rebuilt upon every 'updatePixDiffs()' call.
     static SDL_Surface* getCapturedScreenSurf();
     /// @return The rectangle of the captured part of the screen specified during Xcalibur::init (this is 'dispArea').
     static Rect getCapturedScreenRect();
-    /// @return The list of areas not updated by 'updatePixDiffs()'.
+    /// @return The list of rectangular areas not updated by 'updatePixDiffs()'.
     static std::vector<nch::Rect> getIgnoredPixAreas();
+    /// @return The compiled mask of pixels tracked by 'updatePixDiffs()'. Use this to include/exclude polygons or bitmaps, not just rectangles.
+    static nch::RegionMask& getPixMask();
     /// @return The list of pixels that have changed between the 2nd last call and last call of 'updatePixDiffs()'.
+    /// @return Builds a new std::map on every call - prefer 'visitPixDiffs()' or 'getPixDiffRuns()' for large changes.
     static std::map<std::pair<int, int>, nch::Color> getPixDiffs();
+    /// @brief Call 'visitor' for every run of changed pixels found by the last 'updatePixDiffs()' (top to bottom, left to right). Nothing is copied.
+    static void visitPixDiffs(const std::function<void(const PixDiffRun&)>& visitor);
+    /// @return The runs of changed pixels found by the last 'updatePixDiffs()'. Valid until the next 'updatePixDiffs()'.
+    static const std::vector<PixDiffRun>& getPixDiffRuns();
+    /// @return The number of changed pixels and a list of rectangles (in 'dispArea' coordinates) covering all of them.
+    static PixDiffSummary getPixDiffSummary();
 
     /// @brief Specify an area of the screen to NOT track pixel changes during 'updatePixDiffs' calls. Makes that function less expensive.
-    /// @param r A new rectangular area to ignore.
+    /// @brief Costs O(rows) regardless of the size of 'r'.
+    /// @param r A new rectangular area to ignore, edges included (x1()..x2(), y1()..y2()).
     static void addIgnoredPixSet(const nch::Rect& r);
-    /// @brief Reset all rectangles (clear 'ignoredPixAreas') added by 'addIgnoredPixSet()'.
+    /// @brief Same as 'addIgnoredPixSet()' but for an arbitrary polygon (even-odd rule).
+    /// @param pts The vertices of the polygon, relative to 'dispArea'.
+    static void addIgnoredPixPolygon(const std::vector<nch::Vec2i>& pts);
+    /// @brief Reset all areas (clear 'ignoredPixAreas') added by 'addIgnoredPixSet()' and friends so every pixel is tracked again.
     static void resetPixSet();
 private:
+    static void captureScreen();
+    static void uploadScreenTex();
+    static bool ensureScreenTex();
+    static bool ensureScreenSurf();
+    static void ensurePixMask();
+    static void freeAreaImg();
+
     static bool initted;
     static SDL_Texture* screenTex;
     static SDL_Surface* screenSurf;
     static SDL_Renderer* rend;
+    static std::vector<uint8_t> texShadow;
+    static std::vector<nch::Rect> texDirtyRects;
 
     static XImage* ximg;
     static Display* disp;
     static XShmSegmentInfo shmSegInfo;
     static nch::Rect dispArea;
+    static XImage* areaImg;
+    static XShmSegmentInfo areaShmSegInfo;
+    static std::mutex areaMtx;          //Guards the 2 above
 
-    static std::set<std::pair<int, int>> pixSet;
+    static nch::RegionMask pixMask;
+    static bool pixMaskReady;
     static std::vector<nch::Rect> ignoredPixAreas;
-    static std::map<std::pair<int, int>, nch::Color> pixDiffs;
+    static std::vector<PixDiffRun> diffRuns;
+    static std::vector<uint32_t> diffPixBuf;
+    static uint64_t numDiffPixels;
 }; }
\ No newline at end of file
@@ -29,8 +29,8 @@ void XcaliburDebugScreen::draw(SDL_Renderer* rend)
     TexUtils::clearTexture(rend, dbOverlay);
     SDL_SetRenderTarget(rend, dbOverlay);
     {
-        //Draw ignored pixel areas onto 'dbOverlay'
-        auto iAreas = Xcalibur::getIgnoredPixAreas();
+        //Draw ignored pixel areas (anything excluded from the pixel mask) onto 'dbOverlay'
+        auto iAreas = Xcalibur::getPixMask().toRects(true);
         SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_BLEND);
         for(int i = 0; i<iAreas.size(); i++) {
             SDL_SetRenderDrawColor(rend, 255, 0, 0, 100);
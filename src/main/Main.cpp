@@ -5,6 +5,7 @@
 #include <nch/cpp-utils/timer.h>
 #include <nch/sdl-utils/main-loop-driver.h>
 #include <nch/sdl-utils/texture-utils.h>
+#include <nch/xcr/LatencyProbe.h>
 #include <nch/xcr/MiscTools.h>
 #include <nch/xcr/Xcalibur.h>
 #include <nch/xcr/XTools.h>
@@ -27,6 +28,9 @@ int Main::numTicks = 0;
 std::vector<Rect> indicators;
 
 int main(int argc, char** args) {
+    if(argc>1 && std::string(args[1])=="--latency-probe") {
+        return Main::latencyProbe(argc, args);
+    }
     Main m; return 0;
 }
 Main::Main()
@@ -104,6 +108,44 @@ void Main::draw()
     SDL_RenderPresent(rend);
 }
 
+int Main::latencyProbe(int argc, char** args)
+{
+    //Usage: --latency-probe <x> <y> <w> <h> [trials] [click|<xdotool key>]
+    if(argc<6) {
+        printf("Usage: %s --latency-probe <x> <y> <w> <h> [trials=20] [click|<key>]\n", args[0]);
+        printf("Injects a left click at the center of the area (or presses <key>) and measures how long it takes for the area to change.\n");
+        return 1;
+    }
+    LatencyProbeOptions opts;
+    opts.roi = Rect(atoi(args[2]), atoi(args[3]), atoi(args[4]), atoi(args[5]));
+    if(argc>6) opts.numTrials = atoi(args[6]);
+    std::string action = argc>7 ? args[7] : "click";
+
+    //Build the events injected on every trial
+    std::vector<InputEvent> events(2);
+    if(action=="click") {
+        events[0].type = InputEvent::MOUSE_DOWN;    events[1].type = InputEvent::MOUSE_UP;
+    } else {
+        events[0].type = InputEvent::KEY_DOWN;      events[1].type = InputEvent::KEY_UP;
+        events[0].key = events[1].key = action;
+    }
+
+    //Capture-only Xcalibur (no window/renderer)
+    Xcalibur::init(nullptr);
+    //Hover once up front, so that hover effects aren't measured as a response to the click
+    if(action=="click") {
+        XTools::setMouseXY(Vec2i(opts.roi.r.x+opts.roi.r.w/2, opts.roi.r.y+opts.roi.r.h/2));
+        Timer::sleep(opts.settleMS);
+    }
+    LatencyStats stats = LatencyProbe::measure(events, opts);
+    Log::log("Latency of \"%s\": %s", action.c_str(), LatencyProbe::toString(stats).c_str());
+    for(int i = 0; i<stats.samplesMS.size(); i++) {
+        printf("%.3f\n", stats.samplesMS[i]);
+    }
+    Xcalibur::free();
+    return stats.numTimeouts==stats.numTrials ? 2 : 0;
+}
+
 bool Main::tests()
 {
     return true;
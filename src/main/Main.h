@@ -9,6 +9,8 @@ public:
     ~Main();
 
     static SDL_Renderer* getRenderer();
+    /// @brief Command line tool (--latency-probe): measure input-to-display latency of an area of the screen and print the distribution.
+    static int latencyProbe(int argc, char** args);
 private:
     static void tick();
     static void draw();